@@ -3,11 +3,16 @@
 #include <stdint.h>
 
 #include <concepts>
-#include <map>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 
+#include "../src/LightService.h"
 #include "../src/Service.h"
+#include "../src/ServiceRegistry.h"
+#include "../src/ShardRouter.h"
 
 template <typename T>
 concept is_wstr_name = std::same_as<T, const wchar_t*>;
@@ -23,72 +28,119 @@ public:
 
 	SC_HANDLE scm_handle();
 
-	// Derived class must have `static const wchar_t* service_name` member
+	// Derived class must have `static const wchar_t* service_name` member.
+	// Services may be added and removed while the dispatcher runs, see ServiceRegistry
 	template <is_service_t T>
 	void add()
 	{
 		// Insert if not exist
-		m_ServicesMap.emplace(T::service_name, std::make_shared<T>());
+		if (m_Registry.contains(T::service_name)) {
+			return;
+		}
+
+		auto svc					 = std::make_shared<T>();
+		svc->cfg.function_main		 = service_main<T>;
+		svc->cfg.function_handler_ex = service_handler;
+		m_Registry.insert(T::service_name, std::move(svc));
+	}
+
+	// Register `count` instances of T named <service_name>_<index>, see ShardRouter.
+	// A command pipe, a journal and a snapshot set by T are suffixed the same way, the shards
+	// never share them. `configure` adjusts each shard, e.g. its cfg.placement
+	template <is_service_t T>
+	void add_shards(uint32_t count, std::function<void(Service::config& cfg, uint32_t shard)> configure = {})
+	{
+		std::lock_guard<std::mutex> g(m_NamesMtx);
+		for (uint32_t shard = 0; shard < count; shard++) {
+			auto name = ShardRouter::shard_name(T::service_name, shard);
+			if (m_Registry.contains(name)) {
+				continue;
+			}
+
+			auto svc							 = std::make_shared<T>();
+			svc->cfg.configuration.lpServiceName = m_ShardNames.emplace_back(std::move(name)).c_str();
+			svc->cfg.function_main				 = shard_main;
+			svc->cfg.function_handler_ex		 = service_handler;
+			if (svc->cfg.command_pipe) {
+				auto& pipe			  = m_ShardNames.emplace_back(ShardRouter::shard_name(svc->cfg.command_pipe, shard));
+				svc->cfg.command_pipe = pipe.c_str();
+			}
+			if (svc->cfg.journal_path) {
+				auto path			  = ShardRouter::shard_path(svc->cfg.journal_path, shard);
+				svc->cfg.journal_path = m_ShardNames.emplace_back(std::move(path)).c_str();
+			}
+			if (svc->cfg.snapshot_path) {
+				auto path			   = ShardRouter::shard_path(svc->cfg.snapshot_path, shard);
+				svc->cfg.snapshot_path = m_ShardNames.emplace_back(std::move(path)).c_str();
+			}
+			if (configure) {
+				configure(svc->cfg, shard);
+			}
+			m_Registry.insert(svc->cfg.configuration.lpServiceName, std::move(svc));
+		}
 	}
 
+	// A running service keeps running until it is stopped, it is only no longer found
 	template <is_service_t T>
 	void remove()
 	{
 		// Remove if exist
-		m_ServicesMap.erase(T::service_name);
+		m_Registry.erase(T::service_name);
+	}
+
+	// Any service or shard by its name
+	std::shared_ptr<Service> get(std::wstring_view name)
+	{
+		return m_Registry.find(name);
 	}
 
 	template <is_service_t T>
 	std::shared_ptr<Service> get()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name];
-		}
-
-		return {};
+		return m_Registry.find(T::service_name);
 	}
 
 	template <is_service_t T>
 	bool run()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name]->Service::run();	// Run the base
+		if (auto svc = get<T>()) {
+			return svc->Service::run();	 // Run the base
 		}
 		return false;
 	}
 
 	template <is_service_t T>
-	void stop()
+	bool stop()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name]->Service::stop();	 // Run the base
+		if (auto svc = get<T>()) {
+			return svc->Service::stop();  // Run the base
 		}
 		return false;
 	}
 
 	template <is_service_t T>
-	void pause()
+	bool pause()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name]->Service::pause();  // Run the base
+		if (auto svc = get<T>()) {
+			return svc->Service::pause();	// Run the base
 		}
 		return false;
 	}
 
 	template <is_service_t T>
-	void install()
+	bool install()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name]->install();  // Run virtual
+		if (auto svc = get<T>()) {
+			return svc->install();	// Run virtual
 		}
 		return false;
 	}
 
 	template <is_service_t T>
-	void uninstall()
+	bool uninstall()
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			return m_ServicesMap[T::service_name]->uninstall();	 // Run virtual
+		if (auto svc = get<T>()) {
+			return svc->uninstall();	 // Run virtual
 		}
 		return false;
 	}
@@ -96,19 +148,31 @@ public:
 	template <is_service_t T>
 	void main(DWORD argc, LPWSTR* argv)
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			m_ServicesMap[T::service_name]->main(argc, argv);  // Run virtual
+		if (auto svc = get<T>()) {
+			svc->main(argc, argv);	// Run virtual
 		}
 	}
 
 	template <is_service_t T>
 	void handler(DWORD control)
 	{
-		if (m_ServicesMap.contains(T::service_name)) {
-			m_ServicesMap[T::service_name]->handler(control);  // Run virtual
+		if (auto svc = get<T>()) {
+			svc->handler(control);	// Run virtual
 		}
 	}
 
+	// Light services are dispatched, installed and uninstalled along with the services
+	LightHost& light_host()
+	{
+		return m_LightHost;
+	}
+
+	// Tasks of the services, shared fairly between them, see Service::submit
+	FairScheduler& scheduler()
+	{
+		return m_Scheduler;
+	}
+
 	// start all installed services
 	void run_all();
 
@@ -126,7 +190,35 @@ public:
 private:
 	SCMDispatcher();  // The only place that open SCM handle (except utilities)
 
+	// SCM entry points generated for each service type by add<T>,
+	// the main holds its service for the run and the handler gets it as the context.
+	template <is_service_t T>
+	static void __stdcall service_main(DWORD argc, LPWSTR* argv)
+	{
+		if (auto svc = instance()->get<T>()) {
+			svc->main(argc, argv);	// Run virtual
+		}
+	}
+
+	// A shard is found by the name the SCM started it with
+	static void __stdcall shard_main(DWORD argc, LPWSTR* argv)
+	{
+		auto svc = argc ? instance()->get(argv[0]) : nullptr;
+		if (svc) {
+			svc->main(argc, argv);	// Run virtual
+		}
+	}
+
+	static DWORD __stdcall service_handler(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context)
+	{
+		return static_cast<Service*>(context)->handler_ex(control, eventType, eventData, context);  // Run virtual
+	}
+
 	static std::shared_ptr<SCMDispatcher> m_Instance;
-	std::map<std::wstring_view, std::shared_ptr<Service>> m_ServicesMap;
+	ServiceRegistry m_Registry;
+	std::mutex m_NamesMtx;
+	std::deque<std::wstring> m_ShardNames;	// stable storage of the generated names
+	LightHost m_LightHost;
+	FairScheduler m_Scheduler;
 	SC_HANDLE m_SCM = NULL;
 };
@@ -0,0 +1,333 @@
+#include "CommandChannel.h"
+
+#include <string.h>
+
+#include "RAII.h"
+
+namespace
+{
+constexpr DWORD pipe_buffer = 64 * 1024;
+
+std::wstring pipe_path(std::wstring_view name)
+{
+	return L"\\\\.\\pipe\\" + std::wstring(name);
+}
+
+void put_u32(std::vector<uint8_t>& buffer, uint32_t value)
+{
+	auto bytes = reinterpret_cast<const uint8_t*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+}
+
+void patch_u32(std::vector<uint8_t>& buffer, size_t offset, uint32_t value)
+{
+	memcpy(buffer.data() + offset, &value, sizeof(value));
+}
+
+bool get_u32(std::span<const uint8_t>& buffer, uint32_t& value)
+{
+	if (buffer.size() < sizeof(value)) {
+		return false;
+	}
+
+	memcpy(&value, buffer.data(), sizeof(value));
+	buffer = buffer.subspan(sizeof(value));
+	return true;
+}
+
+// Wait for an overlapped operation, false if it failed or the cancel event was set first
+bool complete(HANDLE pipe, OVERLAPPED& ov, BOOL done, HANDLE cancel, DWORD& transferred)
+{
+	if (!done) {
+		if (GetLastError() != ERROR_IO_PENDING) {
+			return false;
+		}
+
+		HANDLE events[] = {ov.hEvent, cancel};
+		if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+			CancelIoEx(pipe, &ov);
+			GetOverlappedResult(pipe, &ov, &transferred, TRUE);
+			return false;
+		}
+	}
+
+	return GetOverlappedResult(pipe, &ov, &transferred, FALSE);
+}
+
+// Server side, overlapped pipe
+bool transfer(HANDLE pipe, OVERLAPPED& ov, HANDLE cancel, uint8_t* data, DWORD size, bool write)
+{
+	while (size) {
+		DWORD transferred = 0;
+		BOOL done = write ? WriteFile(pipe, data, size, NULL, &ov) : ReadFile(pipe, data, size, NULL, &ov);
+		if (!complete(pipe, ov, done, cancel, transferred) || !transferred) {
+			return false;
+		}
+
+		data += transferred;
+		size -= transferred;
+	}
+
+	return true;
+}
+
+// Client side, synchronous pipe
+bool transfer(HANDLE pipe, uint8_t* data, DWORD size, bool write)
+{
+	while (size) {
+		DWORD transferred = 0;
+		BOOL done = write ? WriteFile(pipe, data, size, &transferred, NULL)
+						  : ReadFile(pipe, data, size, &transferred, NULL);
+		if (!done || !transferred) {
+			return false;
+		}
+
+		data += transferred;
+		size -= transferred;
+	}
+
+	return true;
+}
+}  // namespace
+
+void CommandServer::on(uint32_t id, handler_t handler)
+{
+	m_Handlers[id] = std::move(handler);
+}
+
+void CommandServer::refuse(DWORD status)
+{
+	m_Refusal.store(status, std::memory_order_relaxed);
+}
+
+void CommandServer::serve(std::wstring_view name, std::stop_token token, LPCWSTR sddl)
+{
+	auto path	  = pipe_path(name);
+	HANDLE cancel = CreateEventW(NULL, TRUE, FALSE, NULL);
+	HANDLE pipe	  = INVALID_HANDLE_VALUE;
+	OVERLAPPED ov{};
+	ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	SecurityAttributes security(sddl);
+	if (!security.get()) {
+		// log.error("Invalid command pipe SDDL (%d)\n", GetLastError());
+	} else if (cancel && ov.hEvent) {
+		std::lock_guard<std::mutex> g(m_InstancesMtx);
+
+		// The instance is kept between the clients, the name is ours until the last thread returns
+		DWORD first = m_Instances ? 0 : FILE_FLAG_FIRST_PIPE_INSTANCE;
+		DWORD mode	= PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
+		pipe		= CreateNamedPipeW(path.c_str(),
+								   PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | first,
+								   mode,
+								   PIPE_UNLIMITED_INSTANCES,
+								   pipe_buffer,	 // out buffer
+								   pipe_buffer,	 // in buffer
+								   0,			 // default timeout
+								   security.get());
+
+		if (pipe == INVALID_HANDLE_VALUE) {
+			// Access denied for the first instance when another process holds the name
+			// log.error("CreateNamedPipeW failed (%d)\n", GetLastError());
+		} else {
+			m_Instances++;
+		}
+	}
+
+	if (pipe != INVALID_HANDLE_VALUE) {
+		std::stop_callback onStop(token, [cancel] { SetEvent(cancel); });
+		std::vector<uint8_t> request;
+		std::vector<uint8_t> reply;
+
+		while (!token.stop_requested()) {
+			DWORD transferred = 0;
+			BOOL connected	  = ConnectNamedPipe(pipe, &ov);
+			if (!connected) {
+				connected = GetLastError() == ERROR_PIPE_CONNECTED ||
+							complete(pipe, ov, FALSE, cancel, transferred);
+			}
+
+			uint32_t size = 0;
+			auto header	  = reinterpret_cast<uint8_t*>(&size);
+			while (connected && transfer(pipe, ov, cancel, header, sizeof(size), false)) {
+				if (size > max_frame) {
+					// log.error("Command frame too large (%d)\n", size);
+					break;
+				}
+
+				request.resize(size);
+				if (!transfer(pipe, ov, cancel, request.data(), size, false)) {
+					break;
+				}
+
+				execute(request, reply);
+
+				if (!transfer(pipe, ov, cancel, reply.data(), static_cast<DWORD>(reply.size()), true)) {
+					break;
+				}
+			}
+
+			DisconnectNamedPipe(pipe);
+		}
+
+		CloseHandle(pipe);
+		std::lock_guard<std::mutex> g(m_InstancesMtx);
+		m_Instances--;
+	}
+
+	if (ov.hEvent) {
+		CloseHandle(ov.hEvent);
+	}
+
+	if (cancel) {
+		CloseHandle(cancel);
+	}
+}
+
+void CommandServer::execute(std::span<const uint8_t> request, std::vector<uint8_t>& reply)
+{
+	reply.clear();
+	put_u32(reply, 0);	// frame size
+	put_u32(reply, 0);	// replies count
+
+	uint32_t count	  = 0;
+	uint32_t executed = 0;
+	auto refusal	  = m_Refusal.load(std::memory_order_relaxed);
+	get_u32(request, count);
+
+	while (executed < count) {
+		uint32_t id		= 0;
+		uint32_t length = 0;
+		if (!get_u32(request, id) || !get_u32(request, length) || length > request.size()) {
+			break;	// malformed, the client sees less replies than commands
+		}
+
+		auto payload = request.first(length);
+		request		 = request.subspan(length);
+
+		auto handler = m_Handlers.find(id);
+		if (refusal != NO_ERROR) {
+			put_u32(reply, refusal);
+			put_u32(reply, 0);
+		} else if (handler == m_Handlers.end()) {
+			put_u32(reply, ERROR_CALL_NOT_IMPLEMENTED);
+			put_u32(reply, 0);
+		} else {
+			auto result = handler->second(payload);
+			put_u32(reply, NO_ERROR);
+			put_u32(reply, static_cast<uint32_t>(result.size()));
+			reply.insert(reply.end(), result.begin(), result.end());
+		}
+
+		executed++;
+	}
+
+	patch_u32(reply, 0, static_cast<uint32_t>(reply.size() - sizeof(uint32_t)));
+	patch_u32(reply, sizeof(uint32_t), executed);
+}
+
+CommandClient::~CommandClient()
+{
+	close();
+}
+
+bool CommandClient::connect(std::wstring_view name, DWORD timeout)
+{
+	close();
+	auto path = pipe_path(name);
+
+	for (int attempt = 0; attempt < 2; attempt++) {
+		m_Pipe = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+		if (m_Pipe != INVALID_HANDLE_VALUE) {
+			return true;
+		}
+
+		// All instances are busy serving other clients
+		if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(path.c_str(), timeout)) {
+			break;
+		}
+	}
+
+	// log.error("Cannot connect to %ls (%d)\n", path.c_str(), GetLastError());
+	return false;
+}
+
+void CommandClient::close()
+{
+	if (m_Pipe != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_Pipe);
+		m_Pipe = INVALID_HANDLE_VALUE;
+	}
+
+	m_Batch.clear();
+	m_Queued = 0;
+}
+
+void CommandClient::queue(uint32_t id, std::span<const uint8_t> payload)
+{
+	if (m_Batch.empty()) {
+		put_u32(m_Batch, 0);  // frame size
+		put_u32(m_Batch, 0);  // commands count
+	}
+
+	put_u32(m_Batch, id);
+	put_u32(m_Batch, static_cast<uint32_t>(payload.size()));
+	m_Batch.insert(m_Batch.end(), payload.begin(), payload.end());
+	m_Queued++;
+}
+
+bool CommandClient::flush(std::vector<CommandReply>& replies)
+{
+	replies.clear();
+	if (!m_Queued) {
+		return true;
+	}
+
+	auto queued = m_Queued;
+	patch_u32(m_Batch, 0, static_cast<uint32_t>(m_Batch.size() - sizeof(uint32_t)));
+	patch_u32(m_Batch, sizeof(uint32_t), queued);
+
+	bool sent = transfer(m_Pipe, m_Batch.data(), static_cast<DWORD>(m_Batch.size()), true);
+	m_Batch.clear();
+	m_Queued = 0;
+
+	uint32_t size = 0;
+	if (!sent || !transfer(m_Pipe, reinterpret_cast<uint8_t*>(&size), sizeof(size), false) ||
+		size > CommandServer::max_frame) {
+		return false;
+	}
+
+	m_Reply.resize(size);
+	if (!transfer(m_Pipe, m_Reply.data(), size, false)) {
+		return false;
+	}
+
+	std::span<const uint8_t> reply = m_Reply;
+	uint32_t count				   = 0;
+	get_u32(reply, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t status = 0;
+		uint32_t length = 0;
+		if (!get_u32(reply, status) || !get_u32(reply, length) || length > reply.size()) {
+			return false;
+		}
+
+		replies.push_back({status, {reply.begin(), reply.begin() + length}});
+		reply = reply.subspan(length);
+	}
+
+	return replies.size() == queued;
+}
+
+bool CommandClient::call(uint32_t id, std::span<const uint8_t> payload, CommandReply& reply)
+{
+	std::vector<CommandReply> replies;
+	queue(id, payload);
+	if (!flush(replies)) {
+		return false;
+	}
+
+	reply = std::move(replies.front());
+	return true;
+}
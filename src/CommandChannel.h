@@ -0,0 +1,82 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Local command channel over a named pipe (\\.\pipe\<name>).
+//
+// A request frame is `u32 size` followed by `size` bytes of `u32 count` and `count` commands,
+// each command is `u32 id, u32 length, payload[length]`.
+// The reply frame has the same layout with `u32 status` in place of the id, one reply per command.
+
+struct CommandReply {
+	DWORD status;  // NO_ERROR, ERROR_CALL_NOT_IMPLEMENTED for an unknown command or the refusal status
+	std::vector<uint8_t> payload;
+};
+
+class CommandServer
+{
+public:
+	using handler_t = std::function<std::vector<uint8_t>(std::span<const uint8_t> payload)>;
+
+	static constexpr uint32_t max_frame = 16 * 1024 * 1024;
+
+	// SYSTEM, the administrators and the account of the service
+	static constexpr LPCWSTR default_sddl		= L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)";
+	static constexpr uint32_t default_instances = 4;  // clients served at a time by the service
+
+	// Register before the service starts, handlers are not guarded against a running server
+	void on(uint32_t id, handler_t handler);
+
+	// Answer each command with `status` instead of running it, NO_ERROR to run them again
+	void refuse(DWORD status);
+
+	// Keep a pipe instance and serve its clients one after the other on the calling thread until the
+	// token is stopped, call from several threads to serve several clients at a time.
+	// The first instance claims the name, remote clients and clients `sddl` denies can't connect
+	void serve(std::wstring_view name, std::stop_token token, LPCWSTR sddl = default_sddl);
+
+private:
+	void execute(std::span<const uint8_t> request, std::vector<uint8_t>& reply);
+
+	std::unordered_map<uint32_t, handler_t> m_Handlers;
+	std::atomic<DWORD> m_Refusal{NO_ERROR};
+	std::mutex m_InstancesMtx;
+	uint32_t m_Instances = 0;  // created by the serving threads
+};
+
+class CommandClient
+{
+public:
+	CommandClient() = default;
+	~CommandClient();
+
+	CommandClient(const CommandClient&)			   = delete;
+	CommandClient& operator=(const CommandClient&) = delete;
+
+	bool connect(std::wstring_view name, DWORD timeout = 5000);
+	void close();
+
+	// Add a command to the current batch
+	void queue(uint32_t id, std::span<const uint8_t> payload);
+
+	// Send the batch in a single frame, replies are in the queued order
+	bool flush(std::vector<CommandReply>& replies);
+
+	// Single round trip for a single command
+	bool call(uint32_t id, std::span<const uint8_t> payload, CommandReply& reply);
+
+private:
+	HANDLE m_Pipe     = INVALID_HANDLE_VALUE;
+	uint32_t m_Queued = 0;
+	std::vector<uint8_t> m_Batch;
+	std::vector<uint8_t> m_Reply;
+};
@@ -0,0 +1,267 @@
+#include "ControlTrace.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "Service.h"
+
+namespace
+{
+int64_t qpc()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+int64_t qpc_frequency()
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart;
+}
+
+ULONGLONG to_us(int64_t ticks, int64_t frequency)
+{
+	return static_cast<ULONGLONG>(ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency);
+}
+}  // namespace
+
+ControlTrace::~ControlTrace()
+{
+	close();
+}
+
+bool ControlTrace::create(std::wstring_view path)
+{
+	close();
+
+	std::lock_guard<std::mutex> g(m_FileMtx);
+	m_File = CreateFileW(std::wstring(path).c_str(),
+						 GENERIC_WRITE,
+						 FILE_SHARE_READ,
+						 NULL,
+						 CREATE_ALWAYS,
+						 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+						 NULL);
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		// log.error("Cannot create trace %ls (%d)\n", path.data(), GetLastError());
+		return false;
+	}
+
+	Header header{magic, version, qpc_frequency()};
+	DWORD written = 0;
+	if (!WriteFile(m_File, &header, sizeof(header), &written, NULL) || written != sizeof(header)) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> p(m_Mtx);
+		m_Pending.clear();
+		m_Pending.reserve(batch);
+		m_Dropped.store(0, std::memory_order_relaxed);
+		m_Start = qpc();
+		m_Open	= true;
+	}
+
+	m_Flusher = std::jthread([this](std::stop_token token) { run(token); });
+	return true;
+}
+
+void ControlTrace::close()
+{
+	{
+		std::lock_guard<std::mutex> g(m_Mtx);
+		m_Open = false;	 // The records written from now on are ignored
+	}
+
+	if (m_Flusher.joinable()) {
+		m_Flusher.request_stop();
+		m_Flusher.join();
+	}
+
+	flush();  // the records written until close
+
+	std::lock_guard<std::mutex> g(m_FileMtx);
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+}
+
+void ControlTrace::write(Kind kind, uint32_t a, uint32_t b, uint32_t c)
+{
+	auto now = qpc();
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	if (!m_Open) {
+		return;
+	}
+
+	if (m_Pending.size() >= max_pending) {
+		m_Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	m_Pending.push_back({now - m_Start, kind, {}, a, b, c});
+	if (m_Pending.size() == batch) {
+		m_Cv.notify_one();
+	}
+}
+
+void ControlTrace::flush()
+{
+	// The file lock keeps the batches in order between the flusher and a caller
+	std::lock_guard<std::mutex> f(m_FileMtx);
+	{
+		std::lock_guard<std::mutex> g(m_Mtx);
+		m_Writing.swap(m_Pending);
+	}
+
+	if (m_Writing.empty() || m_File == INVALID_HANDLE_VALUE) {
+		m_Writing.clear();
+		return;
+	}
+
+	DWORD size	  = static_cast<DWORD>(m_Writing.size() * sizeof(Record));
+	DWORD written = 0;
+	if (!WriteFile(m_File, m_Writing.data(), size, &written, NULL) || written != size) {
+		// log.warning("Trace write failed (%d)\n", GetLastError());
+	}
+	m_Writing.clear();
+}
+
+void ControlTrace::run(std::stop_token token)
+{
+	while (!token.stop_requested()) {
+		{
+			std::unique_lock<std::mutex> lock(m_Mtx);
+			m_Cv.wait_for(lock, token, std::chrono::milliseconds(flush_interval), [this] {
+				return m_Pending.size() >= batch;
+			});
+		}
+		flush();
+	}
+}
+
+bool ControlTrace::load(std::wstring_view path, Header& header, std::vector<Record>& records)
+{
+	HANDLE file = CreateFileW(std::wstring(path).c_str(),
+							  GENERIC_READ,
+							  FILE_SHARE_READ | FILE_SHARE_WRITE,
+							  NULL,
+							  OPEN_EXISTING,
+							  FILE_FLAG_SEQUENTIAL_SCAN,
+							  NULL);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	bool loaded = false;
+	do {
+		LARGE_INTEGER size;
+		DWORD read = 0;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart < sizeof(Header) ||
+			!ReadFile(file, &header, sizeof(header), &read, NULL) || read != sizeof(header)) {
+			break;
+		}
+
+		if (header.magic != magic || header.version != version || header.frequency <= 0) {
+			// log.error("Not a control trace: %ls\n", path.data());
+			break;
+		}
+
+		// A trace cut by a crash ends with a partial record, drop it
+		auto count = static_cast<size_t>((size.QuadPart - sizeof(Header)) / sizeof(Record));
+		records.resize(count);
+
+		DWORD bytes = static_cast<DWORD>(count * sizeof(Record));
+		loaded		= ReadFile(file, records.data(), bytes, &read, NULL) && read == bytes;
+	} while (false);
+
+	CloseHandle(file);
+	return loaded;
+}
+
+bool ControlReplayer::load(std::wstring_view path)
+{
+	m_Records.clear();
+	return ControlTrace::load(path, m_Header, m_Records);
+}
+
+ControlReplayer::Stats ControlReplayer::replay(Service& svc, double speed)
+{
+	Stats stats;
+
+	// Host a service that doesn't run under the SCM
+	std::thread idle;
+	if (!svc.cfg.stop_event) {
+		auto state = svc.s.get_state();
+		if (state != ServiceStates::installed && state != ServiceStates::stopped) {
+			// log.error("Replay needs an installed or stopped service\n");
+			return stats;
+		}
+
+		if (!svc.create_events()) {
+			svc.close_events();
+			return stats;
+		}
+
+		idle = std::thread(&Service::idle, &svc);
+		if (!svc.Service::run()) {
+			// The idle thread runs the stop, a failed start doesn't replay
+			SetEvent(svc.cfg.stop_event);
+			idle.join();
+			svc.close_events();
+			return stats;
+		}
+	}
+
+	auto frequency = qpc_frequency();
+	auto begin	   = qpc();
+
+	for (auto& record : m_Records) {
+		if (record.kind != ControlTrace::Kind::control) {
+			continue;
+		}
+
+		if (speed > 0) {
+			// Sleep the coarse part and spin the last ms, controls in a storm are microseconds apart
+			auto due = begin + static_cast<int64_t>(record.time * (static_cast<double>(frequency) /
+																   m_Header.frequency) / speed);
+			for (auto now = qpc(); now < due; now = qpc()) {
+				auto left = to_us(due - now, frequency);
+				if (left > 2000) {
+					Sleep(static_cast<DWORD>(left / 1000 - 1));
+				} else {
+					YieldProcessor();
+				}
+			}
+		}
+
+		// The event data isn't traced, the session change gets the traced session id
+		WTSSESSION_NOTIFICATION session{sizeof(session), record.c};
+		LPVOID data = record.a == SERVICE_CONTROL_SESSIONCHANGE ? &session : nullptr;
+
+		auto start = qpc();
+		svc.handler_ex(record.a, record.b, data, &svc);	 // Run virtual
+		auto elapsed = to_us(qpc() - start, frequency);
+
+		stats.controls++;
+		stats.dispatch += elapsed;
+		stats.max_dispatch = std::max(stats.max_dispatch, elapsed);
+	}
+
+	if (idle.joinable()) {
+		SetEvent(svc.cfg.stop_event);
+		idle.join();
+		svc.close_events();
+	}
+
+	stats.duration = to_us(qpc() - begin, frequency);
+	return stats;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Service;
+
+// Binary trace of the SCM traffic of a service, the controls it received and the statuses it reported.
+// The file is a header followed by fixed size records, timestamps are QPC ticks from the trace start.
+// Writers only append to memory, a flusher thread writes the records, never the SCM handler thread.
+class ControlTrace
+{
+public:
+	static constexpr uint32_t magic	  = 0x43525443;	 // CTRC
+	static constexpr uint32_t version = 1;
+
+	enum class Kind : uint8_t {
+		control = 1,  // a = control, b = event type, c = session id of a session change
+		status		  // a = state, b = exit code, c = wait hint
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		int64_t frequency;	// QPC ticks per second
+	};
+
+	struct Record {
+		int64_t time;  // QPC ticks since the trace start
+		Kind kind;
+		uint8_t reserved[3];
+		uint32_t a;
+		uint32_t b;
+		uint32_t c;
+	};
+
+	ControlTrace() = default;
+	~ControlTrace();
+
+	ControlTrace(const ControlTrace&)			 = delete;
+	ControlTrace& operator=(const ControlTrace&) = delete;
+
+	bool create(std::wstring_view path);
+	void close();
+
+	// Callable from any thread, the records are written in batches by the flusher.
+	// Records beyond max_pending are dropped while the file falls behind
+	void write(Kind kind, uint32_t a, uint32_t b, uint32_t c);
+
+	// Write the pending records on the calling thread
+	void flush();
+
+	uint64_t dropped() const
+	{
+		return m_Dropped.load(std::memory_order_relaxed);
+	}
+
+	static bool load(std::wstring_view path, Header& header, std::vector<Record>& records);
+
+private:
+	static constexpr size_t batch		  = 4096;  // records
+	static constexpr size_t max_pending	  = 64 * batch;
+	static constexpr DWORD flush_interval = 1000;  // ms
+
+	void run(std::stop_token token);
+
+	std::mutex m_FileMtx;  // held across a write, taken before m_Mtx
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	std::vector<Record> m_Writing;
+
+	std::mutex m_Mtx;
+	std::condition_variable_any m_Cv;
+	bool m_Open		= false;
+	int64_t m_Start = 0;
+	std::vector<Record> m_Pending;
+	std::atomic<uint64_t> m_Dropped = 0;
+	std::jthread m_Flusher;
+};
+
+// Drive a service through the controls of a trace, for reproducing control storms as benchmarks.
+// An installed service that isn't running under the SCM is hosted by the replayer for the duration
+// of the replay, its status reports are then dropped by SetServiceStatus, record them with a second
+// trace to compare.
+class ControlReplayer
+{
+public:
+	struct Stats {
+		uint32_t controls	   = 0;
+		ULONGLONG duration	   = 0;	 // us of the whole replay
+		ULONGLONG dispatch	   = 0;	 // us spent in the control handler
+		ULONGLONG max_dispatch = 0;	 // us of the slowest control
+	};
+
+	bool load(std::wstring_view path);
+
+	// `speed` scales the original pace, 2 replays twice as fast, 0 sends the controls back to back.
+	// A hosted service must be installed or stopped, it is stopped again when the replay ends.
+	// Nothing is replayed (0 controls) when the service can't be started
+	Stats replay(Service& svc, double speed = 1.0);
+
+private:
+	ControlTrace::Header m_Header{};
+	std::vector<ControlTrace::Record> m_Records;
+};
@@ -0,0 +1,94 @@
+#include "CpuAccount.h"
+
+#include <algorithm>
+
+namespace
+{
+ULONGLONG to_ticks(const FILETIME& time)
+{
+	return static_cast<ULONGLONG>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+}
+}  // namespace
+
+CpuAccount::~CpuAccount()
+{
+	for (auto& thread : m_Threads) {
+		if (thread.owned) {
+			CloseHandle(thread.handle);
+		}
+	}
+}
+
+void CpuAccount::enter(HANDLE handle)
+{
+	// A real handle, the pseudo handle means the calling thread to the samplers
+	bool owned = !handle;
+	if (owned && !DuplicateHandle(GetCurrentProcess(),
+								  GetCurrentThread(),
+								  GetCurrentProcess(),
+								  &handle,
+								  THREAD_QUERY_LIMITED_INFORMATION,
+								  FALSE,
+								  0)) {
+		return;
+	}
+
+	// The time before entering isn't the service's
+	Thread thread{GetCurrentThreadId(), handle, owned, {}};
+	FILETIME creation, exit, kernel, user;
+	if (GetThreadTimes(handle, &creation, &exit, &kernel, &user)) {
+		thread.last = {to_ticks(user), to_ticks(kernel)};
+	}
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Threads.push_back(thread);
+}
+
+void CpuAccount::leave()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	auto it = std::find_if(m_Threads.begin(), m_Threads.end(), [](auto& thread) {
+		return thread.id == GetCurrentThreadId();
+	});
+
+	if (it != m_Threads.end()) {
+		sample(*it);
+		if (it->owned) {
+			CloseHandle(it->handle);
+		}
+		m_Threads.erase(it);
+	}
+}
+
+void CpuAccount::phase(Phase phase)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	for (auto& thread : m_Threads) {
+		sample(thread);
+	}
+	m_Phase = phase;
+}
+
+CpuAccount::Times CpuAccount::get(Phase phase)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	for (auto& thread : m_Threads) {
+		sample(thread);
+	}
+	return m_Times[static_cast<size_t>(phase)];
+}
+
+void CpuAccount::sample(Thread& thread)
+{
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(thread.handle, &creation, &exit, &kernel, &user)) {
+		return;
+	}
+
+	// Add the time since the last sample to the current phase
+	Times now{to_ticks(user), to_ticks(kernel)};
+	auto& times = m_Times[static_cast<size_t>(m_Phase)];
+	times.user += now.user - thread.last.user;
+	times.kernel += now.kernel - thread.last.kernel;
+	thread.last = now;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// CPU time of the framework threads of a service, attributed to the lifecycle phase it was spent in.
+// The threads are sampled when the phase changes and when queried, each thread samples itself
+// once more when it leaves.
+class CpuAccount
+{
+public:
+	enum class Phase : uint8_t {
+		start = 0,
+		running,  // resume included
+		pause,	  // pausing and paused
+		stop,
+		COUNT
+	};
+
+	struct Times {
+		ULONGLONG user	 = 0;  // 100ns units
+		ULONGLONG kernel = 0;
+	};
+
+	~CpuAccount();
+
+	// Account the calling thread until it leaves. `handle` is a real handle of the thread kept open
+	// by the caller, e.g. a pooled worker entering many accounts, NULL duplicates one
+	void enter(HANDLE handle = NULL);
+	void leave();
+
+	void phase(Phase phase);
+
+	Times get(Phase phase);
+
+private:
+	struct Thread {
+		DWORD id;
+		HANDLE handle;
+		bool owned;	 // duplicated by enter, closed by leave
+		Times last;
+	};
+
+	void sample(Thread& thread);
+
+	std::mutex m_Mtx;
+	std::vector<Thread> m_Threads;
+	Phase m_Phase = Phase::start;
+	std::array<Times, static_cast<size_t>(Phase::COUNT)> m_Times{};
+};
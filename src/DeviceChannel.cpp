@@ -0,0 +1,269 @@
+#include "DeviceChannel.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <utility>
+
+namespace
+{
+// Left in the IO_STATUS_BLOCK by a request the I/O manager rejected before it reached the driver
+constexpr ULONG_PTR status_unsuccessful = 0xC0000001;
+
+// Only an error severity status isn't queued to the port, a warning is completed like a success
+bool nt_error(ULONG_PTR status)
+{
+	return (static_cast<uint32_t>(status) >> 30) == 3;
+}
+}  // namespace
+
+DeviceChannel::~DeviceChannel()
+{
+	close();
+}
+
+bool DeviceChannel::open(std::wstring_view device, uint32_t depth, DWORD bufferSize)
+{
+	close();
+	if (!depth || !bufferSize) {
+		return false;
+	}
+
+	auto path = L"\\\\.\\" + std::wstring(device);
+	m_Device  = CreateFileW(path.c_str(),
+							GENERIC_READ | GENERIC_WRITE,
+							0,
+							NULL,
+							OPEN_EXISTING,
+							FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+							NULL);
+	if (m_Device == INVALID_HANDLE_VALUE) {
+		// log.error("Cannot open %ls (%d)\n", path.c_str(), GetLastError());
+		return false;
+	}
+
+	m_Port = CreateIoCompletionPort(m_Device, NULL, 0, 0);
+	if (!m_Port) {
+		// log.error("CreateIoCompletionPort failed (%d)\n", GetLastError());
+		close();
+		return false;
+	}
+
+	// Complete on the submitting thread what the driver completed at once, without a port round trip
+	m_SkipOnSuccess = SetFileCompletionNotificationModes(
+		m_Device, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE);
+
+	m_Buffers = static_cast<uint8_t*>(
+		VirtualAlloc(NULL, size_t(depth) * bufferSize * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	if (!m_Buffers) {
+		// log.error("VirtualAlloc failed (%d)\n", GetLastError());
+		close();
+		return false;
+	}
+
+	m_BufferSize = bufferSize;
+	m_Slots		 = std::make_unique<Slot[]>(depth);
+	m_Free.reserve(depth);
+
+	for (uint32_t i = 0; i < depth; i++) {
+		m_Slots[i].input  = m_Buffers + size_t(i) * bufferSize * 2;
+		m_Slots[i].output = m_Slots[i].input + bufferSize;
+		m_Free.push_back(depth - 1 - i);
+	}
+
+	return true;
+}
+
+bool DeviceChannel::close(DWORD timeout)
+{
+	bool drained = true;
+	if (m_Device != INVALID_HANDLE_VALUE) {
+		CancelIoEx(m_Device, NULL);
+	}
+
+	if (m_Port) {
+		// Release the reapers, then take over the cancelled requests.
+		// A reaper passes on the releases it took for the others, post again only if one is still late
+		m_Closing.store(true, std::memory_order_release);
+		for (auto reapers = m_Reapers.load(); reapers; reapers = m_Reapers.load()) {
+			for (auto i = reapers; i; i--) {
+				PostQueuedCompletionStatus(m_Port, 0, 0, NULL);
+			}
+			WaitOnAddress(&m_Reapers, &reapers, sizeof(reapers), release_wait);
+		}
+
+		// A driver without a cancel routine holds a request until it completes it
+		auto deadline = GetTickCount64() + timeout;
+		while (m_InFlight.load()) {
+			auto now = GetTickCount64();
+			if (timeout != INFINITE && now >= deadline) {
+				drained = false;
+				break;
+			}
+			dequeue(timeout == INFINITE ? INFINITE : static_cast<DWORD>(deadline - now));
+		}
+
+		CloseHandle(m_Port);
+		m_Port = NULL;
+		m_Closing.store(false, std::memory_order_relaxed);
+	}
+
+	if (m_Device != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_Device);
+		m_Device = INVALID_HANDLE_VALUE;
+	}
+
+	if (drained) {
+		if (m_Buffers) {
+			VirtualFree(m_Buffers, 0, MEM_RELEASE);
+		}
+		m_Slots.reset();
+	} else {
+		m_Slots.release();	// leaked with the buffers, the held requests still own them
+		m_InFlight.store(0, std::memory_order_relaxed);
+	}
+
+	m_Buffers = nullptr;
+	m_Free.clear();
+	m_BufferSize	= 0;
+	m_SkipOnSuccess = false;
+	return drained;
+}
+
+bool DeviceChannel::submit(const Request& request, DWORD timeout)
+{
+	return submit(Request(request), timeout);
+}
+
+bool DeviceChannel::submit(Request&& request, DWORD timeout)
+{
+	if (!m_Slots || request.input.size() > m_BufferSize || request.output_size > m_BufferSize) {
+		return false;
+	}
+
+	Slot* slot = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(m_Mtx);
+		auto wait = std::chrono::milliseconds(timeout);
+		if (!m_FreeCv.wait_for(lock, wait, [this] { return !m_Free.empty(); })) {
+			return false;  // `depth` requests are in flight
+		}
+
+		slot = &m_Slots[m_Free.back()];
+		m_Free.pop_back();
+	}
+
+	memcpy(slot->input, request.input.data(), request.input.size());
+	slot->output_size = request.output_size;
+	slot->done		  = std::move(request.done);
+
+	return issue(*slot, request.code, static_cast<DWORD>(request.input.size()));
+}
+
+size_t DeviceChannel::submit(std::span<const Request> requests, DWORD timeout)
+{
+	size_t issued = 0;
+	for (auto& request : requests) {
+		if (!submit(request, timeout)) {
+			break;
+		}
+		issued++;
+	}
+
+	return issued;
+}
+
+void DeviceChannel::reap(std::stop_token token)
+{
+	m_Reapers.fetch_add(1);
+	{
+		std::stop_callback onStop(token, [this] { PostQueuedCompletionStatus(m_Port, 0, 0, NULL); });
+
+		uint32_t releases = 0;
+		while (!token.stop_requested() && !m_Closing.load(std::memory_order_acquire)) {
+			releases += dequeue(INFINITE);
+		}
+
+		// A batch may hold the releases of the other reapers, keep one and pass on the rest
+		for (; releases > 1; releases--) {
+			PostQueuedCompletionStatus(m_Port, 0, 0, NULL);
+		}
+	}
+	m_Reapers.fetch_sub(1);
+	WakeByAddressAll(&m_Reapers);
+}
+
+bool DeviceChannel::issue(Slot& slot, DWORD code, DWORD inputSize)
+{
+	slot.ov			 = {};
+	slot.ov.Internal = status_unsuccessful;
+	m_InFlight.fetch_add(1, std::memory_order_relaxed);
+
+	BOOL done =
+		DeviceIoControl(m_Device, code, slot.input, inputSize, slot.output, slot.output_size, NULL, &slot.ov);
+
+	// A warning (e.g. ERROR_MORE_DATA) fails the call but still queues the completion,
+	// the reaper owns the slot then and calls back with the warning
+	if (!done && GetLastError() != ERROR_IO_PENDING && nt_error(slot.ov.Internal)) {
+		// log.error("DeviceIoControl %X failed (%d)\n", code, GetLastError());
+		slot.done = nullptr;
+		release(slot);
+		return false;
+	}
+
+	if (done && m_SkipOnSuccess) {
+		DWORD transferred = 0;
+		GetOverlappedResult(m_Device, &slot.ov, &transferred, FALSE);
+		complete(slot, NO_ERROR, transferred);
+	}
+
+	return true;
+}
+
+void DeviceChannel::complete(Slot& slot, DWORD error, DWORD transferred)
+{
+	if (slot.done) {
+		slot.done(error, {slot.output, transferred});
+		slot.done = nullptr;
+	}
+
+	m_Completed.fetch_add(1, std::memory_order_relaxed);
+	release(slot);
+}
+
+void DeviceChannel::release(Slot& slot)
+{
+	{
+		std::lock_guard<std::mutex> g(m_Mtx);
+		m_Free.push_back(static_cast<uint32_t>(&slot - m_Slots.get()));
+	}
+	m_FreeCv.notify_one();
+	m_InFlight.fetch_sub(1, std::memory_order_release);
+}
+
+uint32_t DeviceChannel::dequeue(DWORD timeout)
+{
+	OVERLAPPED_ENTRY entries[reap_batch];
+	ULONG count = 0;
+	if (!GetQueuedCompletionStatusEx(m_Port, entries, reap_batch, &count, timeout, FALSE)) {
+		return 0;
+	}
+
+	uint32_t releases = 0;
+	for (ULONG i = 0; i < count; i++) {
+		if (!entries[i].lpOverlapped) {
+			releases++;
+			continue;
+		}
+
+		auto& slot		  = *reinterpret_cast<Slot*>(entries[i].lpOverlapped);
+		DWORD transferred = 0;
+		DWORD error		  = NO_ERROR;
+		if (!GetOverlappedResult(m_Device, &slot.ov, &transferred, FALSE)) {
+			error = GetLastError();
+		}
+		complete(slot, error, transferred);
+	}
+
+	return releases;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+// Asynchronous device control channel to a driver.
+// Requests are issued with overlapped DeviceIoControl and the submitter doesn't wait for the device,
+// up to `depth` requests are in flight. The completions are dequeued in batches from an I/O completion
+// port by a few reaper threads and handed to the callback of each request.
+// The buffers are registered when the channel opens, a slot per in flight request with its input and
+// output buffers and its OVERLAPPED. A request copies its input, its callback is moved into the slot
+// and allocates nothing when it fits the std::function small buffer (e.g. a pointer capture).
+class DeviceChannel
+{
+public:
+	// The output is valid only during the call
+	using completion_t = std::function<void(DWORD error, std::span<const uint8_t> output)>;
+
+	struct Request {
+		DWORD code;	 // IOCTL
+		std::span<const uint8_t> input;
+		DWORD output_size;
+		completion_t done;
+	};
+
+	DeviceChannel() = default;
+	~DeviceChannel();
+
+	DeviceChannel(const DeviceChannel&)			   = delete;
+	DeviceChannel& operator=(const DeviceChannel&) = delete;
+
+	// Open \\.\<device>, `depth` slots with `bufferSize` bytes for the input and for the output
+	bool open(std::wstring_view device, uint32_t depth = 64, DWORD bufferSize = 4096);
+
+	// Cancel the requests in flight, their callbacks get ERROR_OPERATION_ABORTED,
+	// and wait for the reapers to return. Call once the submitters are done.
+	// False when the driver still held requests after `timeout` ms, their slots and buffers are leaked
+	// since the driver may still complete into them
+	bool close(DWORD timeout = INFINITE);
+
+	// Issue a request, waits up to `timeout` ms for a slot while `depth` requests are in flight.
+	// False without calling back when no slot freed, the request exceeds the buffers or the device
+	// refused it. A request the device completed at once is called back on the submitting thread
+	bool submit(Request&& request, DWORD timeout = INFINITE);
+
+	// Copies the callback
+	bool submit(const Request& request, DWORD timeout = INFINITE);
+
+	// Issue the requests in order, returns how many were issued, copies the callbacks
+	size_t submit(std::span<const Request> requests, DWORD timeout = INFINITE);
+
+	// Call back the completed requests until the token is stopped or the channel closes.
+	// Run on a few service workers, a callback may submit but must not wait for a slot
+	void reap(std::stop_token token);
+
+	uint32_t in_flight() const
+	{
+		return m_InFlight.load(std::memory_order_relaxed);
+	}
+
+	uint64_t completed() const
+	{
+		return m_Completed.load(std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr ULONG reap_batch	= 64;
+	static constexpr DWORD release_wait = 100;	// ms before close posts the releases again
+
+	struct Slot {
+		OVERLAPPED ov;	// first, the dequeued OVERLAPPED is the slot
+		uint8_t* input;
+		uint8_t* output;
+		DWORD output_size;
+		completion_t done;
+	};
+
+	bool issue(Slot& slot, DWORD code, DWORD inputSize);
+	void complete(Slot& slot, DWORD error, DWORD transferred);
+	void release(Slot& slot);
+
+	// Returns the reaper releases it dequeued
+	uint32_t dequeue(DWORD timeout);
+
+	HANDLE m_Device		 = INVALID_HANDLE_VALUE;
+	HANDLE m_Port		 = NULL;
+	uint8_t* m_Buffers	 = nullptr;	 // page aligned, an input and an output buffer per slot
+	DWORD m_BufferSize	 = 0;
+	bool m_SkipOnSuccess = false;  // an immediate completion isn't queued to the port
+	std::unique_ptr<Slot[]> m_Slots;
+
+	std::mutex m_Mtx;
+	std::condition_variable m_FreeCv;
+	std::vector<uint32_t> m_Free;  // slots
+
+	std::atomic<uint32_t> m_InFlight{0};
+	std::atomic<uint32_t> m_Reapers{0};
+	std::atomic<bool> m_Closing{false};
+	std::atomic<uint64_t> m_Completed{0};
+};
@@ -0,0 +1,55 @@
+#include "EventBus.h"
+
+#include <utility>
+
+EventBus::~EventBus()
+{
+	auto node = m_Pending.exchange(nullptr, std::memory_order_acquire);
+	while (node) {
+		delete std::exchange(node, node->next);
+	}
+}
+
+void EventBus::post(event_t event)
+{
+	auto node = new Node{std::move(event), m_Pending.load(std::memory_order_relaxed)};
+	while (!m_Pending.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+
+	m_Signal.fetch_add(1, std::memory_order_release);
+	WakeByAddressSingle(&m_Signal);
+}
+
+void EventBus::deliver(std::stop_token token)
+{
+	std::stop_callback wake(token, [this] {
+		m_Signal.fetch_add(1, std::memory_order_release);
+		WakeByAddressSingle(&m_Signal);
+	});
+
+	while (!token.stop_requested()) {
+		auto signal = m_Signal.load(std::memory_order_acquire);
+		auto node	= m_Pending.exchange(nullptr, std::memory_order_acquire);
+		if (!node) {
+			// Sleep until the signal moves from the value read before the exchange
+			WaitOnAddress(&m_Signal, &signal, sizeof(signal), INFINITE);
+			continue;
+		}
+
+		// Take all pending events at once and restore the posting order
+		Node* ordered = nullptr;
+		while (node) {
+			auto next  = node->next;
+			node->next = ordered;
+			ordered	   = node;
+			node	   = next;
+		}
+
+		while (ordered) {
+			std::visit([this](const auto& event) {
+				std::get<EventChannel<std::decay_t<decltype(event)>>>(m_Channels).publish(event);
+			}, ordered->event);
+			delete std::exchange(ordered, ordered->next);
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+// SERVICE_CONTROL_POWEREVENT, eventData is copied only for PBT_POWERSETTINGCHANGE
+struct PowerEvent {
+	DWORD type;	 // PBT_*
+	GUID setting;
+	std::vector<uint8_t> data;
+};
+
+// SERVICE_CONTROL_SESSIONCHANGE
+struct SessionEvent {
+	DWORD type;	 // WTS_*
+	DWORD session_id;
+};
+
+// SERVICE_CONTROL_DEVICEEVENT, data holds the whole DEV_BROADCAST_* structure
+struct DeviceEvent {
+	DWORD type;	 // DBT_*
+	std::vector<uint8_t> data;
+};
+
+// Subscribers list of a single event type.
+// Subscribing copies the list, publishing reads the current list without taking the writers lock.
+// A replaced list is freed once the last publish iterating it returns.
+template <class E>
+class EventChannel
+{
+public:
+	using callback_t = std::function<void(const E&)>;
+
+	uint32_t subscribe(callback_t callback)
+	{
+		std::lock_guard<std::mutex> g(m_Mtx);
+		auto next = std::make_shared<list_t>(*m_Subscribers.load(std::memory_order_relaxed));
+		next->emplace_back(++m_LastId, std::move(callback));
+		m_Subscribers.store(std::move(next), std::memory_order_release);
+		return m_LastId;
+	}
+
+	void unsubscribe(uint32_t id)
+	{
+		std::lock_guard<std::mutex> g(m_Mtx);
+		auto next = std::make_shared<list_t>(*m_Subscribers.load(std::memory_order_relaxed));
+		std::erase_if(*next, [id](const auto& subscriber) { return subscriber.first == id; });
+		m_Subscribers.store(std::move(next), std::memory_order_release);
+	}
+
+	void publish(const E& event) const
+	{
+		// Holds the list, a callback may unsubscribe
+		auto subscribers = m_Subscribers.load(std::memory_order_acquire);
+		for (auto& [id, callback] : *subscribers) {
+			callback(event);
+		}
+	}
+
+private:
+	using list_t = std::vector<std::pair<uint32_t, callback_t>>;
+
+	std::atomic<std::shared_ptr<const list_t>> m_Subscribers{std::make_shared<const list_t>()};
+	std::mutex m_Mtx;  // serialize writers, never taken by publish()
+	uint32_t m_LastId = 0;
+};
+
+// In process bus of the SCM events of a service.
+// The SCM handler thread posts the events, a service worker delivers them to the subscribers.
+class EventBus
+{
+public:
+	using event_t = std::variant<PowerEvent, SessionEvent, DeviceEvent>;
+
+	EventBus() = default;
+	~EventBus();
+
+	template <class E>
+	uint32_t subscribe(typename EventChannel<E>::callback_t callback)
+	{
+		return std::get<EventChannel<E>>(m_Channels).subscribe(std::move(callback));
+	}
+
+	template <class E>
+	void unsubscribe(uint32_t id)
+	{
+		std::get<EventChannel<E>>(m_Channels).unsubscribe(id);
+	}
+
+	// Lock free, doesn't wait for the subscribers
+	void post(event_t event);
+
+	// Delivery loop, run on a service worker until the token is stopped
+	void deliver(std::stop_token token);
+
+private:
+	struct Node {
+		event_t event;
+		Node* next;
+	};
+
+	std::tuple<EventChannel<PowerEvent>, EventChannel<SessionEvent>, EventChannel<DeviceEvent>> m_Channels;
+	std::atomic<Node*> m_Pending{nullptr};	// LIFO, reversed by the delivery loop
+	std::atomic<uint32_t> m_Signal{0};		// WaitOnAddress target
+};
@@ -0,0 +1,376 @@
+#include "FairScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+constexpr TaskClass serve_order[] = {TaskClass::high, TaskClass::normal, TaskClass::background};
+
+int64_t now_us()
+{
+	static const int64_t frequency = [] {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / frequency * 1000000 + counter.QuadPart % frequency * 1000000 / frequency;
+}
+
+void store_max(std::atomic<ULONGLONG>& max, ULONGLONG value)
+{
+	auto current = max.load(std::memory_order_relaxed);
+	while (current < value && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+// The queue the worker is entered in, and its own placement restored after a placed queue
+thread_local const FairScheduler::Queue* t_Entered = nullptr;
+thread_local GROUP_AFFINITY t_Affinity{};
+thread_local int t_Priority = THREAD_PRIORITY_NORMAL;
+thread_local HANDLE t_Thread = NULL;
+}  // namespace
+
+FairScheduler::Metrics FairScheduler::Queue::metrics() const
+{
+	Metrics metrics;
+	metrics.executed	= m_Executed.load(std::memory_order_relaxed);
+	metrics.dropped		= m_Dropped.load(std::memory_order_relaxed);
+	metrics.run_time	= m_RunTime.load(std::memory_order_relaxed);
+	metrics.delay_total = m_DelayTotal.load(std::memory_order_relaxed);
+	metrics.delay_max	= m_DelayMax.load(std::memory_order_relaxed);
+	return metrics;
+}
+
+FairScheduler::~FairScheduler()
+{
+	stop();
+}
+
+void FairScheduler::start(uint32_t workers)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	if (m_Started.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	if (!workers) {
+		workers = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (uint32_t i = 0; i < workers; i++) {
+		m_Workers.push_back(std::make_unique<Worker>());
+	}
+	for (uint32_t i = 0; i < workers; i++) {
+		m_Threads.emplace_back([this, i](std::stop_token token) { work(i, token); });
+	}
+	m_Started.store(true, std::memory_order_release);
+}
+
+void FairScheduler::stop()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	for (auto& thread : m_Threads) {
+		thread.request_stop();
+	}
+	m_Signal.fetch_add(1);
+	WakeByAddressAll(&m_Signal);
+
+	m_Threads.clear();	// join
+
+	// The batches the workers had taken are lost with them
+	for (auto& worker : m_Workers) {
+		for (auto& local : worker->local) {
+			for (auto& task : local) {
+				task.queue->m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+	m_Workers.clear();
+	m_Started.store(false, std::memory_order_relaxed);
+}
+
+std::shared_ptr<FairScheduler::Queue> FairScheduler::attach(TaskClass taskClass,
+															uint32_t weight,
+															TaskHooks hooks)
+{
+	if (!m_Started.load(std::memory_order_acquire)) {
+		start();
+	}
+
+	return std::shared_ptr<Queue>(new Queue(taskClass, std::max(1u, weight), std::move(hooks)));
+}
+
+bool FairScheduler::detach(Queue& queue, DWORD timeout)
+{
+	queue.m_Closed.store(true);
+	{
+		auto& c = m_Classes[static_cast<size_t>(queue.m_Class)];
+		std::lock_guard<std::mutex> g(c.mtx);
+		queue.m_Dropped.fetch_add(queue.m_Tasks.size(), std::memory_order_relaxed);
+		queue.m_Tasks.clear();
+		if (queue.m_Active) {
+			std::erase_if(c.round, [&queue](auto& active) { return active.get() == &queue; });
+			queue.m_Active = false;
+		}
+	}
+
+	// The tasks already taken by the workers are dropped when they reach them.
+	// A task stopping its own service runs on a worker entered in the queue, don't wait for it
+	uint32_t self = t_Entered == &queue ? 1 : 0;
+	auto deadline = GetTickCount64() + timeout;
+	for (auto running = queue.m_Running.load(); running > self; running = queue.m_Running.load()) {
+		auto now = GetTickCount64();
+		if (timeout != INFINITE && now >= deadline) {
+			return false;
+		}
+
+		WaitOnAddress(&queue.m_Running,
+					  &running,
+					  sizeof(running),
+					  timeout == INFINITE ? INFINITE : static_cast<DWORD>(deadline - now));
+	}
+
+	return true;
+}
+
+bool FairScheduler::submit(const std::shared_ptr<Queue>& queue, task_t task)
+{
+	{
+		auto& c = m_Classes[static_cast<size_t>(queue->m_Class)];
+		std::lock_guard<std::mutex> g(c.mtx);
+		if (queue->m_Closed.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		queue->m_Tasks.push_back({std::move(task), queue, now_us(), 0});
+		if (!queue->m_Active) {
+			queue->m_Active = true;
+			c.round.push_back(queue);
+		}
+	}
+
+	notify();
+	return true;
+}
+
+HANDLE FairScheduler::worker_thread()
+{
+	return t_Thread;
+}
+
+void FairScheduler::notify()
+{
+	m_Signal.fetch_add(1);
+	WakeByAddressSingle(&m_Signal);
+}
+
+bool FairScheduler::take(TaskClass taskClass, std::vector<Task>& batch)
+{
+	auto& c = m_Classes[static_cast<size_t>(taskClass)];
+	std::lock_guard<std::mutex> g(c.mtx);
+
+	while (!c.round.empty()) {
+		auto& queue = *c.round.front();
+		queue.m_Deficit -= queue.m_Correction.exchange(0, std::memory_order_relaxed);
+
+		// Its turn, credit it once and pass to the next queue when still in debt
+		if (queue.m_Deficit <= 0) {
+			queue.m_Deficit += quantum * queue.m_Weight;
+			if (queue.m_Deficit <= 0) {
+				c.round.push_back(std::move(c.round.front()));
+				c.round.pop_front();
+				continue;
+			}
+		}
+
+		// As many tasks as the credit covers by their estimated cost
+		uint32_t cost = std::max(1u, queue.m_Cost.load(std::memory_order_relaxed));
+		size_t count  = std::clamp<size_t>(queue.m_Deficit / cost, 1, max_batch);
+		count		  = std::min(count, queue.m_Tasks.size());
+
+		for (size_t i = 0; i < count; i++) {
+			batch.push_back(std::move(queue.m_Tasks.front()));
+			batch.back().charge = cost;
+			queue.m_Tasks.pop_front();
+		}
+		queue.m_Deficit -= int64_t(count) * cost;
+
+		if (queue.m_Tasks.empty()) {
+			queue.m_Active	= false;
+			queue.m_Deficit = 0;  // an idle queue doesn't bank credit
+			c.round.pop_front();
+		} else if (queue.m_Deficit <= 0) {
+			c.round.push_back(std::move(c.round.front()));
+			c.round.pop_front();
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool FairScheduler::steal(uint32_t self, TaskClass taskClass, Task& task)
+{
+	auto index = static_cast<size_t>(taskClass);
+	auto count = static_cast<uint32_t>(m_Workers.size());
+
+	for (uint32_t i = 1; i < count; i++) {
+		auto& victim = *m_Workers[(self + i) % count];
+		std::lock_guard<std::mutex> g(victim.mtx);
+		auto& local = victim.local[index];
+		if (!local.empty()) {
+			task = std::move(local.back());	 // the owner runs from the front
+			local.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool FairScheduler::next(uint32_t self, Task& task)
+{
+	auto& worker = *m_Workers[self];
+	std::vector<Task> batch;
+
+	for (auto taskClass : serve_order) {
+		auto index = static_cast<size_t>(taskClass);
+		{
+			std::lock_guard<std::mutex> g(worker.mtx);
+			auto& local = worker.local[index];
+			if (!local.empty()) {
+				task = std::move(local.front());
+				local.pop_front();
+				return true;
+			}
+		}
+
+		if (take(taskClass, batch)) {
+			task = std::move(batch.front());
+			if (batch.size() > 1) {
+				{
+					std::lock_guard<std::mutex> g(worker.mtx);
+					auto& local = worker.local[index];
+					std::move(batch.begin() + 1, batch.end(), std::back_inserter(local));
+				}
+				notify();  // an idle worker may steal from the batch
+			}
+			return true;
+		}
+
+		if (steal(self, taskClass, task)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FairScheduler::enter(std::shared_ptr<Queue>& entered, const std::shared_ptr<Queue>& queue)
+{
+	if (entered == queue) {
+		return;
+	}
+
+	leave(entered);
+	queue->m_Running.fetch_add(1);
+	entered	  = queue;
+	t_Entered = queue.get();
+	if (queue->m_Hooks.enter) {
+		queue->m_Hooks.enter();
+	}
+}
+
+void FairScheduler::leave(std::shared_ptr<Queue>& entered)
+{
+	if (!entered) {
+		return;
+	}
+
+	auto& queue = *entered;
+	if (queue.m_Hooks.leave) {
+		queue.m_Hooks.leave();
+	}
+	if (queue.m_Hooks.placed) {
+		SetThreadGroupAffinity(GetCurrentThread(), &t_Affinity, NULL);
+		SetThreadPriority(GetCurrentThread(), t_Priority);
+	}
+
+	t_Entered = nullptr;
+	queue.m_Running.fetch_sub(1);
+	if (queue.m_Closed.load()) {
+		WakeByAddressAll(&queue.m_Running);
+	}
+	entered.reset();
+}
+
+void FairScheduler::run(Task& task)
+{
+	auto& queue = *task.queue;
+
+	if (queue.m_Closed.load()) {
+		queue.m_Dropped.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		auto begin = now_us();
+		task.run();
+		auto end = now_us();
+
+		auto delay = static_cast<ULONGLONG>(std::max<int64_t>(begin - task.submitted, 0));
+		auto cost  = end - begin;
+		queue.m_Executed.fetch_add(1, std::memory_order_relaxed);
+		queue.m_RunTime.fetch_add(cost, std::memory_order_relaxed);
+		queue.m_DelayTotal.fetch_add(delay, std::memory_order_relaxed);
+		store_max(queue.m_DelayMax, delay);
+
+		queue.m_Correction.fetch_add(cost - task.charge, std::memory_order_relaxed);
+		auto average = queue.m_Cost.load(std::memory_order_relaxed);
+		queue.m_Cost.store(static_cast<uint32_t>((average * 7 + cost) / 8), std::memory_order_relaxed);
+	}
+}
+
+void FairScheduler::work(uint32_t self, std::stop_token token)
+{
+	GetThreadGroupAffinity(GetCurrentThread(), &t_Affinity);
+	t_Priority = GetThreadPriority(GetCurrentThread());
+	DuplicateHandle(GetCurrentProcess(),
+					GetCurrentThread(),
+					GetCurrentProcess(),
+					&t_Thread,
+					THREAD_QUERY_LIMITED_INFORMATION,
+					FALSE,
+					0);
+
+	Task task;
+	std::shared_ptr<Queue> entered;
+	while (true) {
+		// Stop bumps the signal after the stop request, seen with it or the wait returns
+		auto signal = m_Signal.load();
+		if (token.stop_requested()) {
+			break;
+		}
+
+		if (next(self, task)) {
+			if (task.queue->m_Closed.load()) {
+				task.queue->m_Dropped.fetch_add(1, std::memory_order_relaxed);	// not worth entering
+			} else {
+				enter(entered, task.queue);	 // stays in while the next tasks are of the same queue
+				run(task);
+			}
+			task = {};	// release the queue
+			continue;
+		}
+
+		leave(entered);	 // an idle worker holds no queue
+		WaitOnAddress(&m_Signal, &signal, sizeof(signal), INFINITE);
+	}
+
+	leave(entered);
+	if (t_Thread) {
+		CloseHandle(std::exchange(t_Thread, static_cast<HANDLE>(NULL)));
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+enum class TaskClass : uint8_t {
+	normal = 0,
+	high,		 // served before normal
+	background,	 // served when high and normal have nothing pending
+	COUNT
+};
+
+// Called on a scheduler worker around the tasks of a queue, see FairScheduler
+struct TaskHooks {
+	std::function<void()> enter;  // before the worker runs tasks of the queue
+	std::function<void()> leave;  // after it ran them
+	bool placed = false;		  // enter changes the affinity or the priority, restored after leave
+};
+
+// Cooperative task scheduler shared by the services of the process.
+// Each service submits to its own queue under a class and a weight. The classes are served in priority
+// order, within a class the queues share the workers by deficit round robin: a queue is credited
+// quantum * weight us of run time on its turn and the measured run time of its tasks is charged
+// against it, a saturating service gets its share and no more while the others have work.
+// A worker moves a batch of a queue to its own deque, idle workers steal from the deques of the
+// others in the same class. Tasks aren't preempted, keep them short.
+// A worker enters a queue before running its tasks and leaves it when it switches queue or idles,
+// the hooks of the queue apply the placement and the CPU accounting of its service around that.
+class FairScheduler
+{
+public:
+	using task_t = std::function<void()>;
+
+
+	struct Metrics {
+		uint64_t executed	  = 0;
+		uint64_t dropped	  = 0;	// pending when the queue was detached
+		ULONGLONG run_time	  = 0;	// us
+		ULONGLONG delay_total = 0;	// us from the submit until the task started
+		ULONGLONG delay_max	  = 0;
+	};
+
+	class Queue;
+
+private:
+	struct Task {
+		task_t run;
+		std::shared_ptr<Queue> queue;
+		int64_t submitted;	// us
+		uint32_t charge;	// us charged to the queue when taken
+	};
+
+public:
+	class Queue
+	{
+	public:
+		Metrics metrics() const;
+
+	private:
+		Queue(TaskClass taskClass, uint32_t weight, TaskHooks hooks)
+			: m_Class(taskClass), m_Weight(weight), m_Hooks(std::move(hooks))
+		{
+		}
+
+		const TaskClass m_Class;
+		const uint32_t m_Weight;
+		const TaskHooks m_Hooks;
+
+		// Under the lock of the class
+		std::deque<Task> m_Tasks;
+		int64_t m_Deficit = 0;	// us
+		bool m_Active	  = false;	// in the round of its class
+
+		std::atomic<int64_t> m_Correction{0};  // run time over the charged estimates, applied on its turn
+		std::atomic<uint32_t> m_Cost{initial_cost};	 // us per task, moving average
+		std::atomic<bool> m_Closed{false};
+		std::atomic<uint32_t> m_Running{0};	 // workers entered
+
+		std::atomic<uint64_t> m_Executed{0};
+		std::atomic<uint64_t> m_Dropped{0};
+		std::atomic<ULONGLONG> m_RunTime{0};
+		std::atomic<ULONGLONG> m_DelayTotal{0};
+		std::atomic<ULONGLONG> m_DelayMax{0};
+
+		friend FairScheduler;
+	};
+
+	FairScheduler() = default;
+	~FairScheduler();
+
+	FairScheduler(const FairScheduler&)			   = delete;
+	FairScheduler& operator=(const FairScheduler&) = delete;
+
+	// 0 for a worker per processor, the first attach starts the default
+	void start(uint32_t workers = 0);
+	void stop();
+
+	std::shared_ptr<Queue> attach(TaskClass taskClass, uint32_t weight, TaskHooks hooks = {});
+
+	// Drop the pending tasks and wait up to `timeout` ms for the running ones,
+	// the queue accepts no more tasks. Called from a task of the queue, its own worker isn't waited
+	bool detach(Queue& queue, DWORD timeout);
+
+	// False once the queue was detached
+	bool submit(const std::shared_ptr<Queue>& queue, task_t task);
+
+	// A real handle of the calling worker, open while it runs, NULL off the workers.
+	// The hooks use it rather than opening one on each queue switch
+	static HANDLE worker_thread();
+
+private:
+	static constexpr uint32_t initial_cost = 50;  // us
+	static constexpr int64_t quantum	   = 2000;	// us per weight and turn
+	static constexpr size_t max_batch	   = 32;
+
+	struct Class {
+		std::mutex mtx;
+		std::deque<std::shared_ptr<Queue>> round;  // queues with pending tasks
+	};
+
+	struct Worker {
+		std::mutex mtx;
+		std::array<std::deque<Task>, static_cast<size_t>(TaskClass::COUNT)> local;
+	};
+
+	bool next(uint32_t self, Task& task);
+	bool take(TaskClass taskClass, std::vector<Task>& batch);
+	bool steal(uint32_t self, TaskClass taskClass, Task& task);
+	void enter(std::shared_ptr<Queue>& entered, const std::shared_ptr<Queue>& queue);
+	void leave(std::shared_ptr<Queue>& entered);
+	void run(Task& task);
+	void work(uint32_t self, std::stop_token token);
+	void notify();
+
+	std::mutex m_Mtx;  // start and stop
+	std::array<Class, static_cast<size_t>(TaskClass::COUNT)> m_Classes;
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<std::jthread> m_Threads;
+	std::atomic<bool> m_Started{false};
+	std::atomic<uint32_t> m_Signal{0};	// bumped by each submit, idle workers wait on it
+};
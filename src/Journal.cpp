@@ -0,0 +1,210 @@
+#include "Journal.h"
+
+#include <string.h>
+
+#include <chrono>
+
+Journal::~Journal()
+{
+	close();
+}
+
+uint8_t Journal::check(const Record& record, uint32_t sequence)
+{
+	// Detects a record torn by a system crash, the sequence reached the disk without the fields
+	uint32_t value = record.time.dwLowDateTime ^ record.time.dwHighDateTime ^ sequence ^
+					 (record.from | record.to << 8 | static_cast<uint32_t>(record.phase) << 16);
+	return static_cast<uint8_t>(value ^ value >> 8 ^ value >> 16 ^ value >> 24) | 1;	// never 0
+}
+
+bool Journal::open(std::wstring_view path, uint32_t capacity, DWORD groupWindow)
+{
+	close();
+
+	m_File = CreateFileW(std::wstring(path).c_str(),
+						 GENERIC_READ | GENERIC_WRITE,
+						 FILE_SHARE_READ,  // a single writer
+						 NULL,
+						 OPEN_ALWAYS,
+						 FILE_ATTRIBUTE_NORMAL,
+						 NULL);
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		// log.error("Cannot open journal %ls (%d)\n", path.data(), GetLastError());
+		return false;
+	}
+
+	// An existing journal keeps its capacity
+	bool created = GetLastError() != ERROR_ALREADY_EXISTS;
+	if (!created) {
+		Header header{};
+		DWORD read = 0;
+		if (ReadFile(m_File, &header, sizeof(header), &read, NULL) && read == sizeof(header) &&
+			header.magic == magic && header.version == version && header.capacity) {
+			capacity = header.capacity;
+		} else {
+			created = true;	 // not a journal, start over
+		}
+	}
+
+	auto size = sizeof(Header) + static_cast<uint64_t>(capacity) * sizeof(Record);
+	m_Mapping = CreateFileMappingW(m_File,
+								   NULL,							  // default security attributes
+								   PAGE_READWRITE,					  // read/write access
+								   static_cast<DWORD>(size >> 32),  // size high
+								   static_cast<DWORD>(size),		  // size low
+								   NULL);							  // not named
+
+	m_Header = m_Mapping ? static_cast<Header*>(MapViewOfFile(m_Mapping, FILE_MAP_WRITE, 0, 0, 0)) : nullptr;
+	if (!m_Header) {
+		// log.error("Cannot map journal %ls (%d)\n", path.data(), GetLastError());
+		close();
+		return false;
+	}
+	m_Records = reinterpret_cast<Record*>(m_Header + 1);
+
+	if (created) {
+		memset(m_Header, 0, static_cast<size_t>(size));
+		m_Header->version  = version;
+		m_Header->capacity = capacity;
+		m_Header->magic	   = magic;
+		sync();
+	}
+
+	scan();
+
+	// Clean up after the previous process, its interrupted transition will not finish
+	if (m_Recovery.interrupted) {
+		append(m_Recovery.from, m_Recovery.to, TransitionPhase::revert);
+	}
+
+	m_Window  = groupWindow;
+	m_Flusher = std::jthread([this](std::stop_token token) { run(token); });
+	return true;
+}
+
+void Journal::close()
+{
+	if (m_Flusher.joinable()) {
+		m_Flusher.request_stop();
+		m_Flusher.join();
+	}
+
+	if (m_Header) {
+		sync();
+		UnmapViewOfFile(m_Header);
+		m_Header  = nullptr;
+		m_Records = nullptr;
+	}
+
+	if (m_Mapping) {
+		CloseHandle(m_Mapping);
+		m_Mapping = NULL;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+}
+
+void Journal::scan()
+{
+	m_Recovery		= {};
+	uint32_t latest = 0;
+	Record* last	= nullptr;
+
+	for (uint32_t i = 0; i < m_Header->capacity; i++) {
+		auto& record  = m_Records[i];
+		auto sequence = record.sequence.load(std::memory_order_relaxed);
+
+		// Newer than the latest, modulo the sequence wrap around
+		if (sequence && record.check == check(record, sequence) &&
+			(!last || static_cast<int32_t>(sequence - latest) > 0)) {
+			latest = sequence;
+			last   = &record;
+		}
+	}
+
+	m_Sequence.store(latest, std::memory_order_relaxed);
+	m_Durable = latest;
+	if (!last) {
+		return;
+	}
+
+	m_Recovery.found	   = true;
+	m_Recovery.interrupted = last->phase == TransitionPhase::begin;
+	m_Recovery.from		   = last->from;
+	m_Recovery.to		   = last->to;
+	m_Recovery.state	   = last->phase == TransitionPhase::commit ? last->to : last->from;
+	m_Recovery.time		   = last->time;
+}
+
+void Journal::append(uint8_t from, uint8_t to, TransitionPhase phase)
+{
+	if (!m_Header) {
+		return;
+	}
+
+	auto sequence = m_Sequence.load(std::memory_order_relaxed) + 1;
+	if (!sequence) {
+		sequence = 1;  // 0 marks an empty record
+	}
+
+	auto& record = m_Records[sequence % m_Header->capacity];
+	record.sequence.store(0, std::memory_order_relaxed);  // the overwritten record is invalid meanwhile
+	GetSystemTimeAsFileTime(&record.time);
+	record.from	 = from;
+	record.to	 = to;
+	record.phase = phase;
+	record.check = check(record, sequence);
+	record.sequence.store(sequence, std::memory_order_release);
+
+	std::lock_guard<std::mutex> g(m_Mtx);  // uncontended unless the flusher is checking
+	m_Sequence.store(sequence, std::memory_order_release);
+	m_Cv.notify_all();
+}
+
+void Journal::flush()
+{
+	auto target = m_Sequence.load(std::memory_order_acquire);
+
+	std::unique_lock<std::mutex> lock(m_Mtx);
+	if (!m_Flusher.joinable()) {
+		lock.unlock();
+		sync();
+		return;
+	}
+
+	m_Cv.notify_all();
+	m_Cv.wait(lock, [&] { return static_cast<int32_t>(m_Durable - target) >= 0; });
+}
+
+void Journal::run(std::stop_token token)
+{
+	std::unique_lock<std::mutex> lock(m_Mtx);
+
+	while (true) {
+		if (!m_Cv.wait(lock, token, [this] { return m_Sequence.load(std::memory_order_acquire) != m_Durable; })) {
+			break;	// stopped, close() syncs the rest
+		}
+
+		// Let the transitions of a burst join the batch
+		m_Cv.wait_for(lock, token, std::chrono::milliseconds(m_Window), [] { return false; });
+
+		auto target = m_Sequence.load(std::memory_order_acquire);
+		lock.unlock();
+		sync();
+		lock.lock();
+
+		m_Durable = target;
+		m_Cv.notify_all();
+	}
+}
+
+void Journal::sync()
+{
+	if (!FlushViewOfFile(m_Header, 0) || !FlushFileBuffers(m_File)) {
+		// log.warning("Journal flush failed (%d)\n", GetLastError());
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include "statemachine.h"
+
+// Append only journal of the state machine transitions of a service, in a mapped file.
+// An append is a copy into the mapping, the records survive a crash of the process as soon as
+// they are written. A flusher thread writes the batches appended within the group window to the disk
+// so they also survive a crash of the system.
+// The records are laid in a ring by their sequence, the recovery needs only the latest one.
+class Journal
+{
+public:
+	static constexpr uint32_t magic	  = 0x4C4E524A;	 // JRNL
+	static constexpr uint32_t version = 1;
+
+	struct Recovery {
+		bool found		 = false;  // the journal has records
+		bool interrupted = false;  // the last transition began and didn't commit or revert
+		uint8_t state	 = 0;	   // the last committed state
+		uint8_t from	 = 0;	   // the last transition
+		uint8_t to		 = 0;
+		FILETIME time{};		   // of the last record
+	};
+
+	Journal() = default;
+	~Journal();
+
+	Journal(const Journal&)			   = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	// Map the journal, create it if it doesn't exist, and scan it for the last transition
+	bool open(std::wstring_view path, uint32_t capacity = 64 * 1024, DWORD groupWindow = 10);
+	void close();
+
+	const Recovery& recovery() const
+	{
+		return m_Recovery;
+	}
+
+	// Lock free for the readers of the mapping, appends are serialized by the state machine lock
+	void append(uint8_t from, uint8_t to, TransitionPhase phase);
+
+	// Wait until everything appended so far is on the disk
+	void flush();
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t capacity;	// records
+		uint32_t reserved;
+	};
+
+	struct Record {
+		FILETIME time;
+		uint8_t from;
+		uint8_t to;
+		TransitionPhase phase;
+		uint8_t check;					  // of the fields above and the sequence
+		std::atomic<uint32_t> sequence;	  // written last, 0 for an empty record
+	};
+
+	static uint8_t check(const Record& record, uint32_t sequence);
+
+	void scan();
+	void run(std::stop_token token);
+	void sync();
+
+	HANDLE m_File	  = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping  = NULL;
+	Header* m_Header  = nullptr;
+	Record* m_Records = nullptr;
+	Recovery m_Recovery;
+
+	std::atomic<uint32_t> m_Sequence{0};  // of the last appended record
+	std::mutex m_Mtx;
+	std::condition_variable_any m_Cv;
+	uint32_t m_Durable = 0;	 // the last sequence on the disk
+	DWORD m_Window	   = 10;
+	std::jthread m_Flusher;
+};
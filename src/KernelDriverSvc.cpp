@@ -1,21 +1,10 @@
 #include "KernelDriverSvc.h"
 
 const wchar_t* KernelDriverSvc::service_name = L"simple_driver";
-
-void __stdcall KernelDriverSvceMain(DWORD argc, LPWSTR* argv)
-{
-	SCMDispatcher::instance()->main<KernelDriverSvc>(argc, argv);
-}
-
-void __stdcall KernelDriverSvcHandler(DWORD control)
-{
-	SCMDispatcher::instance()->handler<KernelDriverSvc>(control);
-}
+const wchar_t* KernelDriverSvc::device_name	 = L"simple_driver";
 
 KernelDriverSvc::KernelDriverSvc()
 {
-	cfg.function_main				  = KernelDriverSvceMain;
-	cfg.function_handler			  = KernelDriverSvcHandler;
 	cfg.configuration.lpServiceName	  = service_name;
 	cfg.configuration.dwDesiredAccess = SERVICE_ALL_ACCESS;
 	cfg.configuration.dwServiceType	  = SERVICE_WIN32_SHARE_PROCESS;
@@ -25,4 +14,26 @@ KernelDriverSvc::KernelDriverSvc()
 	cfg.accepted_controls			  = SERVICE_ACCEPT_STOP; /* | SERVICE_ACCEPT_PAUSE_CONTINUE |
 													   SERVICE_ACCEPT_POWEREVENT | SERVICE_ACCEPT_SESSIONCHANGE |
 													   SERVICE_ACCEPT_TIMECHANGE*/
-}
\ No newline at end of file
+}
+
+bool KernelDriverSvc::start()
+{
+	if (!device.open(device_name)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < device_reapers; i++) {
+		spawn([this](std::stop_token token) { device.reap(token); });
+	}
+	return true;
+}
+
+bool KernelDriverSvc::stop()
+{
+	// The reapers were released by the stop. A request the driver holds past the drain timeout
+	// is given up, its buffers are leaked rather than freed under the driver
+	if (!device.close(drain_timeout())) {
+		// log.warning("Device requests held by the driver past %d ms\n", drain_timeout());
+	}
+	return true;
+}
@@ -1,10 +1,22 @@
 #pragma once
 #include <framework.h>
 
+#include "DeviceChannel.h"
+
+// Companion of the simple_driver driver, talks to its device through `device` while running
 class KernelDriverSvc : public Service
 {
 public:
 	using base_t = Service;
 	static const wchar_t* service_name;
+	static const wchar_t* device_name;
 	KernelDriverSvc();
-};
\ No newline at end of file
+
+protected:
+	static constexpr uint32_t device_reapers = 2;
+	DeviceChannel device;  // open from start until stop
+
+private:
+	bool start() override;
+	bool stop() override;
+};
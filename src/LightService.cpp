@@ -0,0 +1,277 @@
+#include "LightService.h"
+
+#include <algorithm>
+#include <utility>
+
+bool LightService::transit(ServiceStates state)
+{
+	auto current = m_State.load(std::memory_order_relaxed);
+	do {
+		if (!ServiceStateMachine::allowed(current, state)) {
+			return false;
+		}
+	} while (!m_State.compare_exchange_weak(current, state, std::memory_order_acq_rel));
+
+	return true;
+}
+
+void LightService::update_status(DWORD state, DWORD exitCode, DWORD waitHint)
+{
+	// Built on report, the light service doesn't keep a SERVICE_STATUS
+	SERVICE_STATUS status{};
+	status.dwServiceType	  = m_Kind->service_type;
+	status.dwCurrentState	  = state;
+	status.dwWin32ExitCode	  = exitCode;
+	status.dwWaitHint		  = waitHint;
+	status.dwControlsAccepted = state == SERVICE_START_PENDING ? 0 : m_Kind->accepted_controls;
+
+	if ((state == SERVICE_RUNNING) || (state == SERVICE_STOPPED)) {
+		m_Checkpoint = 0;
+	} else {
+		m_Checkpoint++;
+	}
+	status.dwCheckPoint = m_Checkpoint;
+
+	if (!SetServiceStatus(m_StatusHandle, &status)) {
+		// log.warning("SetServiceStatus failed (%X)", GetLastError());
+	}
+}
+
+LightHost::LightHost()
+{
+	s_Host = this;
+}
+
+LightHost::~LightHost()
+{
+	if (m_Thread.joinable()) {
+		m_Thread.request_stop();
+		m_Thread.join();
+	}
+
+	if (s_Host == this) {
+		s_Host = nullptr;
+	}
+}
+
+LightService* LightHost::add(std::wstring_view name, const LightKind& kind, void* context)
+{
+	if (m_Index.contains(name)) {
+		return nullptr;
+	}
+
+	auto interned = intern(name);
+	auto& svc	  = m_Services.emplace_back(interned, intern(kind), context);
+	m_Index.emplace(interned, &svc);
+	return &svc;
+}
+
+LightService* LightHost::find(std::wstring_view name)
+{
+	auto it = m_Index.find(name);
+	return it == m_Index.end() ? nullptr : it->second;
+}
+
+DWORD LightHost::control(LightService& svc, DWORD control)
+{
+	if (control != SERVICE_CONTROL_STOP && control != SERVICE_CONTROL_SHUTDOWN) {
+		return service_handler(control, 0, nullptr, &svc);
+	}
+
+	// Posted to this host, the SCM handler posts to the host of the process
+	start_thread();
+	post(svc, control);
+	return NO_ERROR;
+}
+
+void LightHost::table(std::vector<SERVICE_TABLE_ENTRYW>& entries)
+{
+	for (auto& svc : m_Services) {
+		entries.push_back({const_cast<LPWSTR>(svc.m_Name), service_main});
+	}
+}
+
+void LightHost::install_all(SC_HANDLE scm, LPCWSTR binaryPath)
+{
+	for (auto& svc : m_Services) {
+		SC_HANDLE handle = CreateServiceW(scm,						   // SCM database
+										  svc.m_Name,				   // name of service
+										  svc.m_Name,				   // service name to display
+										  SERVICE_ALL_ACCESS,		   // desired access
+										  svc.m_Kind->service_type,	   // service type
+										  svc.m_Kind->start_type,	   // start type
+										  svc.m_Kind->error_control,   // error control type
+										  binaryPath,				   // path to service's binary
+										  NULL,						   // no load ordering group
+										  NULL,						   // no tag identifier
+										  NULL,						   // no dependencies
+										  NULL,						   // LocalSystem account
+										  NULL);					   // no password
+
+		if (!handle) {
+			if (GetLastError() != ERROR_SERVICE_EXISTS) {
+				// log.error("CreateServiceW %ls failed (%d)\n", svc.m_Name, GetLastError());
+			}
+			continue;
+		}
+		CloseServiceHandle(handle);
+	}
+}
+
+void LightHost::uninstall_all(SC_HANDLE scm)
+{
+	for (auto& svc : m_Services) {
+		SC_HANDLE handle = OpenServiceW(scm, svc.m_Name, DELETE);
+		if (!handle) {
+			continue;
+		}
+
+		if (!DeleteService(handle)) {
+			// log.error("DeleteService %ls failed (%d)\n", svc.m_Name, GetLastError());
+		}
+		CloseServiceHandle(handle);
+	}
+}
+
+void __stdcall LightHost::service_main(DWORD argc, LPWSTR* argv)
+{
+	auto host = s_Host;
+	auto svc  = host && argc ? host->find(argv[0]) : nullptr;
+	if (!svc) {
+		return;
+	}
+
+	svc->m_StatusHandle = RegisterServiceCtrlHandlerExW(svc->m_Name, service_handler, svc);
+	if (!svc->m_StatusHandle) {
+		// log.error("RegisterServiceCtrlHandlerExW failed");
+		return;
+	}
+
+	host->start_thread();
+
+	if (!svc->transit(ServiceStates::running)) {
+		return;
+	}
+
+	// Controls are disabled while start pending, a stop can't race the start
+	svc->update_status(SERVICE_START_PENDING, NO_ERROR, 3000);
+	if (svc->m_Kind->start && !svc->m_Kind->start(*svc)) {
+		svc->m_State.store(ServiceStates::stopped, std::memory_order_release);
+		svc->update_status(SERVICE_STOPPED, NO_ERROR, 0);
+		return;
+	}
+	svc->update_status(SERVICE_RUNNING, NO_ERROR, 0);
+
+	// Return the SCM thread, the host thread serves the controls from now on
+}
+
+DWORD __stdcall LightHost::service_handler(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context)
+{
+	auto svc = static_cast<LightService*>(context);
+
+	switch (control) {
+		case SERVICE_CONTROL_INTERROGATE:
+			return NO_ERROR;
+		case SERVICE_CONTROL_STOP:
+		case SERVICE_CONTROL_SHUTDOWN:
+			if (s_Host) {
+				s_Host->post(*svc, control);
+			}
+			return NO_ERROR;
+
+		default:
+			break;
+	}
+
+	return ERROR_CALL_NOT_IMPLEMENTED;
+}
+
+const wchar_t* LightHost::intern(std::wstring_view name)
+{
+	// Bump allocated from chunks, no allocation per name
+	auto size = name.size() + 1;
+	if (m_NamesUsed + size > name_chunk) {
+		m_Names.push_back(std::make_unique<wchar_t[]>(std::max(name_chunk, size)));
+		m_NamesUsed = 0;
+	}
+
+	auto interned = m_Names.back().get() + m_NamesUsed;
+	name.copy(interned, name.size());
+	interned[name.size()] = L'\0';
+	m_NamesUsed += size;
+	return interned;
+}
+
+const LightKind* LightHost::intern(const LightKind& kind)
+{
+	for (auto& interned : m_Kinds) {
+		if (interned == kind) {
+			return &interned;
+		}
+	}
+
+	return &m_Kinds.emplace_back(kind);
+}
+
+void LightHost::start_thread()
+{
+	std::call_once(m_Started, [this] {
+		m_Thread = std::jthread([this](std::stop_token token) { run(token); });
+	});
+}
+
+void LightHost::post(LightService& svc, DWORD control)
+{
+	svc.m_Control.store(control, std::memory_order_relaxed);
+	if (svc.m_Queued.exchange(true, std::memory_order_acq_rel)) {
+		return;	 // already pending, the host picks the latest control
+	}
+
+	svc.m_Next = m_Pending.load(std::memory_order_relaxed);
+	while (!m_Pending.compare_exchange_weak(svc.m_Next, &svc, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+
+	m_Signal.fetch_add(1, std::memory_order_release);
+	WakeByAddressSingle(&m_Signal);
+}
+
+void LightHost::run(std::stop_token token)
+{
+	std::stop_callback wake(token, [this] {
+		m_Signal.fetch_add(1, std::memory_order_release);
+		WakeByAddressSingle(&m_Signal);
+	});
+
+	while (!token.stop_requested()) {
+		auto signal = m_Signal.load(std::memory_order_acquire);
+		auto svc	= m_Pending.exchange(nullptr, std::memory_order_acquire);
+		if (!svc) {
+			// Sleep until the signal moves from the value read before the exchange
+			WaitOnAddress(&m_Signal, &signal, sizeof(signal), INFINITE);
+			continue;
+		}
+
+		// Restore the posting order
+		LightService* ordered = nullptr;
+		while (svc) {
+			auto next = std::exchange(svc->m_Next, ordered);
+			ordered	  = svc;
+			svc		  = next;
+		}
+
+		while (ordered) {
+			svc = std::exchange(ordered, ordered->m_Next);	// before it can be queued again
+			svc->m_Queued.store(false, std::memory_order_release);
+			auto control = svc->m_Control.exchange(0, std::memory_order_acquire);
+
+			if ((control == SERVICE_CONTROL_STOP || control == SERVICE_CONTROL_SHUTDOWN) &&
+				svc->transit(ServiceStates::stopped)) {
+				svc->update_status(SERVICE_STOP_PENDING, NO_ERROR, 3000);
+				if (svc->m_Kind->stop) {
+					svc->m_Kind->stop(*svc);
+				}
+				svc->update_status(SERVICE_STOPPED, NO_ERROR, 0);
+			}
+		}
+	}
+}
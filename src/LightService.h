@@ -0,0 +1,129 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "service_sm.h"
+
+class LightService;
+
+// Cold configuration shared by all the light services of a kind, interned by the host
+struct LightKind {
+	bool (*start)(LightService& svc) = nullptr;	 // on the SCM service main thread, optional
+	void (*stop)(LightService& svc)	 = nullptr;	 // on the host thread, optional
+	DWORD service_type				 = SERVICE_WIN32_SHARE_PROCESS;
+	DWORD start_type				 = SERVICE_DEMAND_START;
+	DWORD error_control				 = SERVICE_ERROR_NORMAL;
+	DWORD accepted_controls			 = SERVICE_ACCEPT_STOP;
+
+	bool operator==(const LightKind&) const = default;
+};
+
+// A service without its own thread, event, configuration or state machine instance,
+// for hosting thousands of small services in one process.
+// The hot fields fit a cache line, the controls of all the light services run on a single host thread.
+class LightService
+{
+public:
+	const wchar_t* name() const
+	{
+		return m_Name;
+	}
+
+	const LightKind& kind() const
+	{
+		return *m_Kind;
+	}
+
+	ServiceStates state() const
+	{
+		return m_State.load(std::memory_order_acquire);
+	}
+
+	void* context = nullptr;  // user data
+
+	// Constructed by the host only, the name and the kind are interned
+	LightService(const wchar_t* name, const LightKind* kind, void* ctx) : context(ctx), m_Name(name), m_Kind(kind)
+	{
+	}
+
+private:
+	bool transit(ServiceStates state);
+	void update_status(DWORD state, DWORD exitCode, DWORD waitHint);
+
+	const wchar_t* m_Name;	// interned by the host
+	const LightKind* m_Kind;
+	SERVICE_STATUS_HANDLE m_StatusHandle = NULL;
+	LightService* m_Next				 = nullptr;	 // pending controls stack of the host
+	std::atomic<DWORD> m_Control{0};				 // latest control waiting for the host thread
+	std::atomic<bool> m_Queued{false};
+	std::atomic<ServiceStates> m_State{ServiceStates::installed};
+	uint16_t m_Checkpoint = 0;
+
+	friend class LightHost;
+};
+
+static_assert(sizeof(LightService) <= 64, "LightService hot fields should fit a cache line");
+
+class LightHost
+{
+public:
+	LightHost();
+	~LightHost();
+
+	LightHost(const LightHost&)			   = delete;
+	LightHost& operator=(const LightHost&) = delete;
+
+	// Register before dispatching, nullptr if the name is taken
+	LightService* add(std::wstring_view name, const LightKind& kind, void* context = nullptr);
+	LightService* find(std::wstring_view name);
+
+	size_t size() const
+	{
+		return m_Services.size();
+	}
+
+	// Hand a control to a light service as the SCM handler does, e.g. from a command of another service.
+	// The host thread starts on the first control if no light service was started yet
+	DWORD control(LightService& svc, DWORD control);
+
+	// Append the SCM table entries of the light services
+	void table(std::vector<SERVICE_TABLE_ENTRYW>& entries);
+
+	void install_all(SC_HANDLE scm, LPCWSTR binaryPath);
+	void uninstall_all(SC_HANDLE scm);
+
+private:
+	static constexpr size_t name_chunk = 64 * 1024;	 // wchar_t per name pool chunk
+
+	static void __stdcall service_main(DWORD argc, LPWSTR* argv);
+	static DWORD __stdcall service_handler(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context);
+
+	const wchar_t* intern(std::wstring_view name);
+	const LightKind* intern(const LightKind& kind);
+	void post(LightService& svc, DWORD control);
+	void start_thread();
+	void run(std::stop_token token);
+
+	static inline LightHost* s_Host = nullptr;	// the SCM service main carries no context
+
+	std::deque<LightService> m_Services;  // stable addresses, no node per service
+	std::unordered_map<std::wstring_view, LightService*> m_Index;
+	std::deque<LightKind> m_Kinds;
+	std::vector<std::unique_ptr<wchar_t[]>> m_Names;
+	size_t m_NamesUsed = name_chunk;
+
+	std::once_flag m_Started;
+	std::atomic<LightService*> m_Pending{nullptr};	// LIFO, reversed by the host thread
+	std::atomic<uint32_t> m_Signal{0};				// WaitOnAddress target
+	std::jthread m_Thread;
+};
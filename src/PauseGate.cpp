@@ -0,0 +1,62 @@
+#include "PauseGate.h"
+
+void PauseGate::enter()
+{
+	m_Running.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PauseGate::leave()
+{
+	m_Running.fetch_sub(1, std::memory_order_release);
+	WakeByAddressAll(&m_Running);
+}
+
+void PauseGate::close()
+{
+	m_Closed.store(1, std::memory_order_seq_cst);
+}
+
+void PauseGate::open()
+{
+	m_Closed.store(0, std::memory_order_release);
+	WakeByAddressAll(&m_Closed);
+}
+
+bool PauseGate::wait_quiesced(DWORD timeout)
+{
+	auto deadline = GetTickCount64() + timeout;
+
+	while (true) {
+		auto running = m_Running.load(std::memory_order_seq_cst);	// ordered after the close
+		if (!running) {
+			return true;
+		}
+
+		auto now = GetTickCount64();
+		if (now >= deadline) {
+			return false;
+		}
+
+		// Any park or leave moves the counter, so a change after the load isn't missed
+		WaitOnAddress(&m_Running, &running, sizeof(running), static_cast<DWORD>(deadline - now));
+	}
+}
+
+void PauseGate::park()
+{
+	uint32_t closed = 1;
+	while (true) {
+		m_Running.fetch_sub(1, std::memory_order_release);
+		WakeByAddressAll(&m_Running);
+
+		while (m_Closed.load(std::memory_order_acquire)) {
+			WaitOnAddress(&m_Closed, &closed, sizeof(closed), INFINITE);
+		}
+
+		// A close between the open and the increment may have seen this worker parked, park again
+		m_Running.fetch_add(1, std::memory_order_seq_cst);
+		if (!m_Closed.load(std::memory_order_seq_cst)) {
+			break;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Quiesce point for the pausable workers of a service.
+// While the gate is open checkpoint() is a single relaxed load, once it closes the workers
+// park at their next checkpoint on WaitOnAddress until the gate opens again.
+class PauseGate
+{
+public:
+	inline void checkpoint()
+	{
+		if (m_Closed.load(std::memory_order_relaxed)) {
+			park();
+		}
+	}
+
+	// A worker taking part in the quiesce, it must reach checkpoint() regularly
+	void enter();
+	void leave();
+
+	void close();
+	void open();
+
+	// Wait up to `timeout` ms for all the entered workers to park
+	bool wait_quiesced(DWORD timeout);
+
+private:
+	void park();
+
+	std::atomic<uint32_t> m_Closed{0};
+	std::atomic<uint32_t> m_Running{0};	 // entered and not parked, WaitOnAddress target of the closer
+};
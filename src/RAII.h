@@ -1,5 +1,7 @@
 #pragma once
 #include <Windows.h>
+#include <sddl.h>
+
 template <typename I, typename R>
 class WinAPI
 {
@@ -42,6 +44,41 @@ private:
 	NTSTATUS m_NtStatus = 0;
 };
 
+// Security attributes of an SDDL string, e.g. L"D:P(A;;GA;;;SY)(A;;GA;;;BA)"
+class SecurityAttributes
+{
+public:
+	SecurityAttributes(LPCWSTR sddl)
+	{
+		auto converted =
+			ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl, SDDL_REVISION_1, &m_Descriptor, NULL);
+		if (!converted) {
+			m_Descriptor = NULL;
+		}
+		m_Attributes = {sizeof(m_Attributes), m_Descriptor, FALSE};
+	}
+
+	~SecurityAttributes()
+	{
+		if (m_Descriptor) {
+			LocalFree(m_Descriptor);
+		}
+	}
+
+	SecurityAttributes(const SecurityAttributes&)			 = delete;
+	SecurityAttributes& operator=(const SecurityAttributes&) = delete;
+
+	// NULL for an invalid SDDL, don't fall back to the default DACL
+	LPSECURITY_ATTRIBUTES get()
+	{
+		return m_Descriptor ? &m_Attributes : NULL;
+	}
+
+private:
+	PSECURITY_DESCRIPTOR m_Descriptor = NULL;
+	SECURITY_ATTRIBUTES m_Attributes{};
+};
+
 template <class T>
 class TempValue
 {
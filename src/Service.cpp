@@ -3,8 +3,28 @@
 #include <filesystem>
 
 #include "RAII.h"
+#include "Tracer.h"
 #include "framework.h"
 
+namespace
+{
+constexpr TraceName trace_main{"lifecycle", "main"};
+constexpr TraceName trace_start{"lifecycle", "start"};
+constexpr TraceName trace_stop{"lifecycle", "stop"};
+constexpr TraceName trace_pause{"lifecycle", "pause"};
+constexpr TraceName trace_resume{"lifecycle", "resume"};
+constexpr TraceName trace_user_start{"override", "start"};
+constexpr TraceName trace_user_stop{"override", "stop"};
+constexpr TraceName trace_user_pause{"override", "pause"};
+constexpr TraceName trace_user_resume{"override", "resume"};
+constexpr TraceName trace_drain{"lifecycle", "drain"};
+constexpr TraceName trace_quiesce{"lifecycle", "quiesce"};
+constexpr TraceName trace_control{"control", "control"};
+constexpr TraceName trace_status{"control", "status"};
+
+thread_local const Service* t_WorkerOf = nullptr;  // the service spawned the calling thread
+}  // namespace
+
 void Service::update_status(DWORD state, DWORD exitCode, DWORD waitHint)
 {
 	cfg.status.dwCurrentState  = state;
@@ -17,7 +37,7 @@ void Service::update_status(DWORD state, DWORD exitCode, DWORD waitHint)
 		cfg.status.dwControlsAccepted = cfg.accepted_controls;
 	}
 
-	if ((state == SERVICE_RUNNING) || (state == SERVICE_STOPPED)) {
+	if ((state == SERVICE_RUNNING) || (state == SERVICE_STOPPED) || (state == SERVICE_PAUSED)) {
 		m_Checkpoint = 0;
 	} else {
 		// report the progress for the current pending state
@@ -25,6 +45,11 @@ void Service::update_status(DWORD state, DWORD exitCode, DWORD waitHint)
 	}
 	cfg.status.dwCheckPoint = m_Checkpoint;
 
+	Tracer::instant(trace_status, state);
+	if (auto trace = m_Trace.load()) {
+		trace->write(ControlTrace::Kind::status, state, exitCode, waitHint);
+	}
+
 	if (!SetServiceStatus(cfg.status_handle, &cfg.status)) {
 		// log.warning("SetServiceStatus failed (%X)", GetLastError());
 	}
@@ -36,22 +61,21 @@ bool Service::is_installed()
 		return true;
 	}
 
-	try {
-		auto t	 = s.transit(decltype(s)::state_t::installed);
-		auto svc = get_handle();
+	auto t = s.try_transit(decltype(s)::state_t::installed);
+	if (!t) {
+		return false;
+	}
 
-		if (!svc) {
-			if (GetLastError() == ERROR_SERVICE_DOES_NOT_EXIST) {
-				return false;
-			}
-			return false;  // return c++23 expected for the error
+	auto svc = get_handle();
+
+	if (!svc) {
+		if (GetLastError() == ERROR_SERVICE_DOES_NOT_EXIST) {
+			return false;
 		}
-		t.commit();
-		return true;
-	} catch (...) {
+		return false;  // return c++23 expected for the error
 	}
-
-	return false;
+	t->commit();
+	return true;
 }
 
 SC_HANDLE Service::get_handle()
@@ -72,83 +96,407 @@ SC_HANDLE Service::get_handle()
 
 void Service::idle()
 {
-	// TODO: consider random wake
-	WaitForSingleObject(cfg.stop_event, INFINITE);
+	place();
+	m_Cpu.enter();
+
+	HANDLE events[] = {cfg.stop_event, m_ControlEvent};
+
+	while (true) {
+		// Wake on the watchdog jittered timer to scan the heartbeats
+		auto wait = WaitForMultipleObjects(2, events, FALSE, watchdog.next_wait());
+		if (wait == WAIT_TIMEOUT) {
+			watchdog.scan([this](const Watchdog::Heartbeat& heartbeat) { escalate(heartbeat); });
+		} else if (wait == WAIT_OBJECT_0 + 1) {
+			// Pause and continue run here, the quiesce must not block the control handler
+			switch (m_PendingControl.exchange(0)) {
+				case SERVICE_CONTROL_PAUSE:
+					Service::pause();
+					break;
+				case SERVICE_CONTROL_CONTINUE:
+					Service::resume();
+					break;
+
+				default:
+					break;
+			}
+		} else {
+			break;
+		}
+	}
 	Service::stop();
+	m_Cpu.leave();
+}
+
+void Service::place()
+{
+	auto& placement = cfg.placement;
+	auto affinity	= placement.affinity;
+
+	if (!affinity.Mask && placement.numa && !GetNumaNodeProcessorMaskEx(placement.numa_node, &affinity)) {
+		// log.warning("Unknown NUMA node %d\n", placement.numa_node);
+	}
+
+	if (affinity.Mask && !SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL)) {
+		// log.warning("SetThreadGroupAffinity failed (%d)\n", GetLastError());
+	}
+
+	if (placement.priority && !SetThreadPriority(GetCurrentThread(), placement.priority)) {
+		// log.warning("SetThreadPriority failed (%d)\n", GetLastError());
+	}
+}
+
+void Service::escalate(const Watchdog::Heartbeat& heartbeat)
+{
+	// log.warning("watchdog: %ls missed its deadline\n", heartbeat.name().c_str());
+
+	switch (heartbeat.escalation()) {
+		case Watchdog::Escalation::status:
+			update_status(cfg.status.dwCurrentState, ERROR_TIMEOUT, cfg.status.dwWaitHint);
+			break;
+		case Watchdog::Escalation::stop:
+			// Stopping with an error triggers the SCM recovery actions
+			m_ExitCode = ERROR_TIMEOUT;
+			SetEvent(cfg.stop_event);
+			break;
+
+		default:
+			break;
+	}
 }
 
 bool Service::start()
 {
 	THREAD_LOCAL_GAURD(true);
-	try {
-		auto t = s.transit(decltype(s)::state_t::running);
-		update_status(SERVICE_START_PENDING, NO_ERROR, 3000);
-		if (!start()) {	 // Call user override if exist
-			return false;
-		}
-		update_status(SERVICE_RUNNING, NO_ERROR, 3000);
-		t.commit();
-		return true;
-	} catch (...) {
+	Tracer::Scope scope(trace_start);
+	auto t = s.try_transit(decltype(s)::state_t::running);
+	if (!t) {
+		return false;
 	}
 
-	return false;
+	m_Cpu.phase(CpuAccount::Phase::start);
+	auto begin	  = GetTickCount64();
+	m_ExitCode	  = NO_ERROR;
+	m_StopSource  = std::stop_source();	 // a fresh token for this run
+	m_WarmStarted = false;
+	commands.refuse(NO_ERROR);
+	timers.resume();  // A run stopped while paused left the wheel and the watchdog suspended
+	watchdog.resume();
+	update_status(SERVICE_START_PENDING, NO_ERROR, m_WaitHint.hint(WaitHint::Transition::start));
+
+	if (cfg.snapshot_path && m_Snapshot.open(cfg.snapshot_path, cfg.snapshot_version)) {
+		load(m_Snapshot.state());
+		m_WarmStarted = true;
+	}
+
+	spawn([this](std::stop_token token) { timers.run(token); });
+	if (cfg.function_handler_ex) {
+		spawn([this](std::stop_token token) { events.deliver(token); });
+	}
+	if (cfg.command_pipe) {
+		for (uint32_t i = 0; i < CommandServer::default_instances; i++) {
+			spawn([this](std::stop_token token) { commands.serve(cfg.command_pipe, token); });
+		}
+	}
+	auto& scheduler = SCMDispatcher::instance()->scheduler();
+	// The tasks run under the placement and in the CPU account of the service like its own workers
+	TaskHooks hooks;
+	hooks.enter = [this] {
+		place();
+		m_Cpu.enter(FairScheduler::worker_thread());  // the worker's own handle, not one per switch
+	};
+	hooks.leave	 = [this] { m_Cpu.leave(); };
+	hooks.placed = cfg.placement.affinity.Mask || cfg.placement.numa || cfg.placement.priority;
+	m_Tasks.store(scheduler.attach(cfg.scheduling.task_class, cfg.scheduling.weight, std::move(hooks)));
+	if (!Tracer::call(trace_user_start, [this] { return start(); })) {  // Call user override if exist
+		m_StopSource.request_stop();  // Release the workers of the failed run
+		auto deadline = GetTickCount64() + drain_timeout();
+		detach_tasks(deadline);
+		drain(deadline);
+		timers.clear();	 // The callbacks may capture the memory of the run
+		m_Snapshot.close();
+		memory.release();
+		m_Cpu.phase(CpuAccount::Phase::stop);
+		return false;
+	}
+	m_ReadyLatency = static_cast<DWORD>(GetTickCount64() - begin);
+	m_WaitHint.observe(WaitHint::Transition::start, m_ReadyLatency);
+	m_Cpu.phase(CpuAccount::Phase::running);
+	update_status(SERVICE_RUNNING, NO_ERROR, 0);
+	t->commit();
+	return true;
 }
 
 bool Service::stop()
 {
 	THREAD_LOCAL_GAURD(true);
-	try {
-		auto t = s.transit(decltype(s)::state_t::stopped);
-		update_status(SERVICE_STOP_PENDING, NO_ERROR, 3000);
-		if (!stop()) {	// Call user override if exist
-			return false;
+	Tracer::Scope scope(trace_stop);
+	auto t = s.try_transit(decltype(s)::state_t::stopped);
+	if (!t) {
+		return false;
+	}
+
+	m_Cpu.phase(CpuAccount::Phase::stop);
+	auto begin	 = GetTickCount64();
+	auto timeout = drain_timeout();
+	auto hint	 = std::min(timeout, m_WaitHint.hint(WaitHint::Transition::stop));
+
+	update_status(SERVICE_STOP_PENDING, NO_ERROR, hint);
+	m_StopSource.request_stop();  // Cancel the workers before the user override
+	m_Gate.open();				  // Release the parked workers to see the cancellation
+	if (!Tracer::call(trace_user_stop, [this] { return stop(); })) {  // Call user override if exist
+		return false;
+	}
+
+	bool drained = detach_tasks(begin + timeout);  // The pending tasks are dropped
+	drained		 = drain(begin + timeout) && drained;
+	if (!drained) {
+		// log.warning("Workers didn't drain within %d ms\n", timeout);
+	}
+	timers.clear();	 // Don't fire the timers of this run in the next one, they may capture its memory
+
+	// A detached worker may still use the state, the loaded snapshot and the memory
+	if (drained) {
+		if (cfg.snapshot_path) {
+			SnapshotWriter snapshot(cfg.snapshot_path);
+			bool saved = save(snapshot) && snapshot.seal(cfg.snapshot_version);
+			m_Snapshot.close();	 // The state may reference the loaded snapshot until now
+			if (saved) {
+				snapshot.publish();
+			}
+		}
+		memory.release();  // After save(), the state may be kept in it
+	}
+	m_ShutdownLatency = static_cast<DWORD>(GetTickCount64() - begin);
+	m_WaitHint.observe(WaitHint::Transition::stop, m_ShutdownLatency);
+	m_WaitHint.save(cfg.configuration.lpServiceName);  // The process may exit with the last stop
+
+	update_status(SERVICE_STOPPED, m_ExitCode, 0);
+	t->commit();
+	return true;
+}
+
+void Service::spawn(std::function<void(std::stop_token)> worker, bool pausable, std::function<void()> wake)
+{
+	std::lock_guard<std::mutex> g(m_WorkersMtx);
+	m_ActiveWorkers++;
+	if (pausable) {
+		m_Gate.enter();
+		if (wake) {
+			m_Wakers.push_back(std::move(wake));
+		}
+	}
+
+	auto state = std::make_shared<WorkerState>();
+	std::thread thread([this, state, pausable, worker = std::move(worker), token = m_StopSource.get_token()] {
+		t_WorkerOf = this;
+		place();
+		m_Cpu.enter();
+		worker(token);
+		m_Cpu.leave();
+		if (pausable) {
+			m_Gate.leave();
+		}
+
+		std::lock_guard<std::mutex> g(m_WorkersMtx);
+		if (state->detached) {
+			m_DetachedWorkers--;
+		} else {
+			state->done = true;
+			m_ActiveWorkers--;
+		}
+		m_WorkersCv.notify_all();
+	});
+	m_Workers.push_back({std::move(thread), std::move(state)});
+}
+
+bool Service::attach_ring(std::wstring_view name,
+						  RingConsumer::handler_t handler,
+						  uint32_t capacity,
+						  uint32_t slotSize,
+						  RingMode mode,
+						  LPCWSTR sddl)
+{
+	auto ring = std::make_shared<RingConsumer>();
+	if (!ring->create(name, capacity, slotSize, mode, sddl)) {
+		return false;
+	}
+
+	spawn(
+		[this, ring, handler = std::move(handler)](std::stop_token token) {
+			std::stop_callback onStop(token, [&ring] { ring->wake(); });
+
+			while (!token.stop_requested()) {
+				checkpoint();  // Stop consuming while paused, the producers get the backpressure
+				ring->consume(handler, 256, INFINITE);
+			}
+		},
+		true,
+		[ring] { ring->wake(); });
+	return true;
+}
+
+bool Service::drain(ULONGLONG deadline)
+{
+	Tracer::Scope scope(trace_drain);
+	std::unique_lock<std::mutex> lock(m_WorkersMtx);
+
+	// A stop from a worker of the service doesn't wait for that worker
+	uint32_t self = t_WorkerOf == this ? 1 : 0;
+	auto idle	  = [this, self] { return m_ActiveWorkers <= self; };
+
+	while (!idle()) {
+		auto now = GetTickCount64();
+		if (now >= deadline) {
+			break;
+		}
+
+		// Report a checkpoint each interval so the SCM knows we are progressing
+		auto wait = std::min<ULONGLONG>(deadline - now, drain_checkpoint);
+		if (!m_WorkersCv.wait_for(lock, std::chrono::milliseconds(wait), idle)) {
+			update_status(SERVICE_STOP_PENDING, NO_ERROR, static_cast<DWORD>(deadline - GetTickCount64()));
+		}
+	}
+
+	bool drained = idle();
+	for (auto& worker : m_Workers) {
+		if (worker.state->done) {
+			worker.thread.join();
+		} else {
+			// Don't hang the stop on a worker ignoring its token, nor join the calling worker
+			worker.state->detached = true;
+			worker.thread.detach();
+			m_ActiveWorkers--;
+			m_DetachedWorkers++;
 		}
-		update_status(SERVICE_STOPPED, NO_ERROR, 3000);
-		t.commit();
+	}
+	m_Workers.clear();
+	m_Wakers.clear();
+
+	return drained;
+}
+
+bool Service::submit(FairScheduler::task_t task)
+{
+	auto tasks = m_Tasks.load();
+	return tasks && SCMDispatcher::instance()->scheduler().submit(tasks, std::move(task));
+}
+
+bool Service::detach_tasks(ULONGLONG deadline)
+{
+	auto tasks = m_Tasks.load();
+	if (!tasks) {
 		return true;
-	} catch (...) {
 	}
 
-	return false;
+	auto now	 = GetTickCount64();
+	auto timeout = deadline > now ? static_cast<DWORD>(deadline - now) : 0;
+	return SCMDispatcher::instance()->scheduler().detach(*tasks, timeout);
+}
+
+bool Service::quiesce(ULONGLONG deadline)
+{
+	Tracer::Scope scope(trace_quiesce);
+	m_Gate.close();
+	{
+		std::lock_guard<std::mutex> g(m_WorkersMtx);
+		for (auto& wake : m_Wakers) {
+			wake();
+		}
+	}
+
+	while (true) {
+		auto now = GetTickCount64();
+		if (now >= deadline || WaitForSingleObject(cfg.stop_event, 0) == WAIT_OBJECT_0) {
+			return false;  // Don't hold a stop behind the pause
+		}
+
+		// Report a checkpoint each interval so the SCM knows we are progressing
+		if (m_Gate.wait_quiesced(static_cast<DWORD>(std::min<ULONGLONG>(deadline - now, drain_checkpoint)))) {
+			return true;
+		}
+		update_status(SERVICE_PAUSE_PENDING, NO_ERROR, static_cast<DWORD>(deadline - GetTickCount64()));
+	}
 }
 
 bool Service::pause()
 {
 	THREAD_LOCAL_GAURD(true);
-	try {
-		auto t = s.transit(decltype(s)::state_t::paused);
-		update_status(SERVICE_PAUSE_PENDING, NO_ERROR, 3000);
-		if (!pause()) {	 // Call user override if exist
-			return false;
-		}
-		update_status(SERVICE_RUNNING, NO_ERROR, 3000);
-		t.commit();
-		return true;
-	} catch (...) {
+	Tracer::Scope scope(trace_pause);
+	auto t = s.try_transit(decltype(s)::state_t::paused);
+	if (!t) {
+		return false;
 	}
 
-	return false;
+	m_Cpu.phase(CpuAccount::Phase::pause);
+	auto begin	 = GetTickCount64();
+	auto timeout = cfg.pause_timeout ? cfg.pause_timeout : default_pause_timeout;
+	auto hint	 = std::min(timeout, m_WaitHint.hint(WaitHint::Transition::pause));
+
+	update_status(SERVICE_PAUSE_PENDING, NO_ERROR, hint);
+	if (!Tracer::call(trace_user_pause, [this] { return pause(); })) {  // Call user override if exist
+		update_status(SERVICE_RUNNING, NO_ERROR, 0);
+		m_Cpu.phase(CpuAccount::Phase::running);
+		return false;
+	}
+
+	timers.suspend();
+	watchdog.suspend();	 // The parked workers don't beat
+	commands.refuse(ERROR_SERVICE_CANNOT_ACCEPT_CTRL);
+	if (!quiesce(begin + timeout)) {
+		// log.warning("Workers didn't park within %d ms\n", timeout);
+		m_Gate.open();
+		commands.refuse(NO_ERROR);
+		timers.resume();
+		watchdog.resume();
+		update_status(SERVICE_RUNNING, NO_ERROR, 0);
+		m_Cpu.phase(CpuAccount::Phase::running);
+		return false;
+	}
+
+	m_QuiesceLatency	= static_cast<DWORD>(GetTickCount64() - begin);
+	m_MaxQuiesceLatency = std::max(m_MaxQuiesceLatency, m_QuiesceLatency);
+	m_WaitHint.observe(WaitHint::Transition::pause, m_QuiesceLatency);
+
+	update_status(SERVICE_PAUSED, NO_ERROR, 0);
+	t->commit();
+	return true;
 }
 
 bool Service::resume()
 {
 	THREAD_LOCAL_GAURD(true);
-	try {
-		auto t = s.transit(decltype(s)::state_t::running);
-		update_status(SERVICE_CONTINUE_PENDING, NO_ERROR, 3000);
-		if (!resume()) {  // Call user override if exist
-			return false;
-		}
-		update_status(SERVICE_RUNNING, NO_ERROR, 3000);
-		t.commit();
-		return true;
-	} catch (...) {
+	Tracer::Scope scope(trace_resume);
+	auto t = s.try_transit(decltype(s)::state_t::running);
+	if (!t) {
+		return false;
 	}
 
-	return false;
+	m_Cpu.phase(CpuAccount::Phase::running);
+	auto begin = GetTickCount64();
+	update_status(SERVICE_CONTINUE_PENDING, NO_ERROR, m_WaitHint.hint(WaitHint::Transition::resume));
+	if (!Tracer::call(trace_user_resume, [this] { return resume(); })) {  // Call user override if exist
+		update_status(SERVICE_PAUSED, NO_ERROR, 0);
+		m_Cpu.phase(CpuAccount::Phase::pause);
+		return false;
+	}
+	m_Gate.open();
+	commands.refuse(NO_ERROR);
+	timers.resume();
+	watchdog.resume();
+
+	m_WaitHint.observe(WaitHint::Transition::resume, static_cast<DWORD>(GetTickCount64() - begin));
+	update_status(SERVICE_RUNNING, NO_ERROR, 0);
+	t->commit();
+	return true;
 }
 
+bool Service::save(SnapshotWriter& snapshot)
+{
+	return false;  // Nothing to hand over
+}
+
+void Service::load(std::span<const uint8_t> state) {}
+
 bool Service::run()
 {
 	THREAD_LOCAL_GAURD(true);
@@ -159,13 +507,18 @@ bool Service::run()
 
 	switch (s.get_state()) {
 		case decltype(s)::state_t::installed:
+		case decltype(s)::state_t::stopped:
 			return Service::start() && run();
 		case decltype(s)::state_t::paused:
 			return Service::resume() && run();
+		case decltype(s)::state_t::running:
+			return true;
 
 		default:
 			break;
 	}
+
+	return false;
 }
 
 std::filesystem::path GetServicePath()
@@ -185,66 +538,63 @@ bool Service::install()
 		return true;
 	}
 
-	try {
-		auto t = s.transit(decltype(s)::state_t::installed);
-
-		do {
-			SC_HANDLE scm = SCMDispatcher::instance()->scm_handle();
-			if (!scm) {
-				break;
-			}
-
-			if (!cfg.configuration.lpBinaryPathName) {
-				m_BinaryPath					   = GetServicePath().native();
-				cfg.configuration.lpBinaryPathName = m_BinaryPath.c_str();
-			}
+	auto t = s.try_transit(decltype(s)::state_t::installed);
+	if (!t) {
+		return false;
+	}
 
-			// Check if executable exist
-			auto fileHandle = CreateFileW(cfg.configuration.lpBinaryPathName,
-										  GENERIC_READ,
-										  FILE_SHARE_READ,
-										  NULL,
-										  OPEN_EXISTING,
-										  FILE_ATTRIBUTE_NORMAL,
-										  NULL);
-
-			if (fileHandle == INVALID_HANDLE_VALUE) {
-				// The file isn't exist
-				// log.error("File not exist: %ls\n", cfg.configuration.lpBinaryPathName);
-				break;
-			}
+	do {
+		SC_HANDLE scm = SCMDispatcher::instance()->scm_handle();
+		if (!scm) {
+			break;
+		}
 
-			// The file exist
-			CloseHandle(fileHandle);
-
-			m_Handle = CreateServiceW(scm,									 // SCM database
-									  cfg.configuration.lpServiceName,		 // name of service
-									  cfg.configuration.lpDisplayName,		 // service name to display
-									  cfg.configuration.dwDesiredAccess,	 // desired access
-									  cfg.configuration.dwServiceType,		 // service type
-									  cfg.configuration.dwStartType,		 // start type
-									  cfg.configuration.dwErrorControl,		 // error control type
-									  cfg.configuration.lpBinaryPathName,	 // path to service's binary
-									  cfg.configuration.lpLoadOrderGroup,	 // load ordering group
-									  cfg.configuration.lpdwTagId,			 // tag identifier
-									  cfg.configuration.lpDependencies,		 // dependencies
-									  cfg.configuration.lpServiceStartName,	 // LocalSystem account
-									  cfg.configuration.lpPassword);		 // password
-
-			if (!m_Handle) {
-				// log.error("CreateServiceW failed (%d)\n", GetLastError());
-				break;
-			}
+		if (!cfg.configuration.lpBinaryPathName) {
+			m_BinaryPath					   = GetServicePath().native();
+			cfg.configuration.lpBinaryPathName = m_BinaryPath.c_str();
+		}
 
-			t.commit();
-			return true;
+		// Check if executable exist
+		auto fileHandle = CreateFileW(cfg.configuration.lpBinaryPathName,
+									  GENERIC_READ,
+									  FILE_SHARE_READ,
+									  NULL,
+									  OPEN_EXISTING,
+									  FILE_ATTRIBUTE_NORMAL,
+									  NULL);
+
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			// The file isn't exist
+			// log.error("File not exist: %ls\n", cfg.configuration.lpBinaryPathName);
+			break;
+		}
 
-		} while (false);
+		// The file exist
+		CloseHandle(fileHandle);
+
+		m_Handle = CreateServiceW(scm,									 // SCM database
+								  cfg.configuration.lpServiceName,		 // name of service
+								  cfg.configuration.lpDisplayName,		 // service name to display
+								  cfg.configuration.dwDesiredAccess,	 // desired access
+								  cfg.configuration.dwServiceType,		 // service type
+								  cfg.configuration.dwStartType,		 // start type
+								  cfg.configuration.dwErrorControl,		 // error control type
+								  cfg.configuration.lpBinaryPathName,	 // path to service's binary
+								  cfg.configuration.lpLoadOrderGroup,	 // load ordering group
+								  cfg.configuration.lpdwTagId,			 // tag identifier
+								  cfg.configuration.lpDependencies,		 // dependencies
+								  cfg.configuration.lpServiceStartName,	 // LocalSystem account
+								  cfg.configuration.lpPassword);		 // password
+
+		if (!m_Handle) {
+			// log.error("CreateServiceW failed (%d)\n", GetLastError());
+			break;
+		}
 
-	} catch (...) {
-	}
+		t->commit();
+		return true;
 
-	return false;
+	} while (false);
 
 	return false;
 }
@@ -255,23 +605,56 @@ bool Service::uninstall()
 		return true;
 	}
 
-	try {
-		auto t = s.transit(decltype(s)::state_t::uninstalled);
-
-		if (DeleteService(m_Handle)) {
-			t.commit();
-			return true;
-		}
+	auto t = s.try_transit(decltype(s)::state_t::uninstalled);
+	if (!t) {
+		return false;
+	}
 
-	} catch (...) {
+	if (DeleteService(m_Handle)) {
+		t->commit();
+		return true;
 	}
 
 	return false;
 }
 
+bool Service::create_events()
+{
+	// consider to use conditinal variable or waitonaddress
+	cfg.stop_event = CreateEventW(NULL,	  // default security attributes
+								  TRUE,	  // manual reset event
+								  FALSE,  // not signaled
+								  NULL);  // no name
+
+	// auto reset, the control itself is in m_PendingControl
+	m_ControlEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+	return cfg.stop_event && m_ControlEvent;
+}
+
+void Service::close_events()
+{
+	if (cfg.stop_event) {
+		CloseHandle(cfg.stop_event);
+		cfg.stop_event = NULL;
+	}
+
+	if (m_ControlEvent) {
+		CloseHandle(m_ControlEvent);
+		m_ControlEvent = NULL;
+	}
+}
+
 void __stdcall Service::main(DWORD argc, LPWSTR* argv)
 {
-	cfg.status_handle = RegisterServiceCtrlHandlerW(cfg.configuration.lpServiceName, cfg.function_handler);
+	Tracer::Scope scope(trace_main);
+	place();  // The SCM thread runs the start
+	if (cfg.function_handler_ex) {
+		cfg.status_handle =
+			RegisterServiceCtrlHandlerExW(cfg.configuration.lpServiceName, cfg.function_handler_ex, this);
+	} else {
+		cfg.status_handle = RegisterServiceCtrlHandlerW(cfg.configuration.lpServiceName, cfg.function_handler);
+	}
 
 	if (!cfg.status_handle) {
 		// log.error("RegisterServiceCtrlHandlerW failed");
@@ -281,18 +664,21 @@ void __stdcall Service::main(DWORD argc, LPWSTR* argv)
 	cfg.status.dwServiceSpecificExitCode = 0;
 	cfg.status.dwServiceType			 = cfg.configuration.dwServiceType;
 
-	// consider to use conditinal variable or waitonaddress
-	cfg.stop_event = CreateEventW(NULL,	  // default security attributes
-								  TRUE,	  // manual reset event
-								  FALSE,  // not signaled
-								  NULL);  // no name
-
-	if (cfg.stop_event == NULL) {
+	if (!create_events()) {
 		update_status(SERVICE_STOPPED, GetLastError(), 0);
 		return;
 	}
 
+	m_WaitHint.load(cfg.configuration.lpServiceName);  // Keep the defaults when it never ran
+
+	if (cfg.journal_path && m_Journal.open(cfg.journal_path)) {
+		s.observe([this](ServiceStates from, ServiceStates to, TransitionPhase phase) {
+			m_Journal.append(static_cast<uint8_t>(from), static_cast<uint8_t>(to), phase);
+		});
+	}
+
 	// at this point we registered to the SCM with handler and created a stop event
+	m_Cpu.enter();
 	std::thread wait_for_stop(&Service::idle, this);
 
 	if (!Service::run()) {
@@ -303,6 +689,7 @@ void __stdcall Service::main(DWORD argc, LPWSTR* argv)
 	if (wait_for_stop.joinable()) {
 		wait_for_stop.join();
 	}
+	m_Cpu.leave();
 }
 
 void __stdcall Service::handler(DWORD control)
@@ -315,7 +702,10 @@ void __stdcall Service::handler(DWORD control)
 
 			break;
 		case SERVICE_CONTROL_PAUSE:
-			// log.debug("pause signal");
+		case SERVICE_CONTROL_CONTINUE:
+			// log.debug("pause/continue signal");
+			m_PendingControl.store(control);
+			SetEvent(m_ControlEvent);
 			break;
 		case SERVICE_CONTROL_POWEREVENT:
 			// log.debug("power event signal");
@@ -328,3 +718,62 @@ void __stdcall Service::handler(DWORD control)
 			break;
 	}
 }
+
+DWORD __stdcall Service::handler_ex(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context)
+{
+	Tracer::instant(trace_control, control);
+	if (auto trace = m_Trace.load()) {
+		auto session = control == SERVICE_CONTROL_SESSIONCHANGE && eventData
+						   ? static_cast<WTSSESSION_NOTIFICATION*>(eventData)->dwSessionId
+						   : 0;
+		trace->write(ControlTrace::Kind::control, control, eventType, session);
+	}
+
+	// Copy the event data, it is valid only until we return to the SCM
+	switch (control) {
+		case SERVICE_CONTROL_POWEREVENT: {
+			PowerEvent event{eventType, {}, {}};
+			if (eventType == PBT_POWERSETTINGCHANGE && eventData) {
+				auto setting  = static_cast<POWERBROADCAST_SETTING*>(eventData);
+				event.setting = setting->PowerSetting;
+				event.data.assign(setting->Data, setting->Data + setting->DataLength);
+			}
+			events.post(std::move(event));
+			break;
+		}
+		case SERVICE_CONTROL_SESSIONCHANGE:
+			if (eventData) {
+				events.post(SessionEvent{eventType, static_cast<WTSSESSION_NOTIFICATION*>(eventData)->dwSessionId});
+			}
+			break;
+		case SERVICE_CONTROL_DEVICEEVENT:
+			if (eventData) {
+				auto header = static_cast<uint8_t*>(eventData);
+				events.post(DeviceEvent{
+					eventType,
+					{header, header + static_cast<DEV_BROADCAST_HDR*>(eventData)->dbch_size}
+				});
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	handler(control);  // Run virtual
+
+	// The controls the base handles, override to accept others
+	switch (control) {
+		case SERVICE_CONTROL_STOP:
+		case SERVICE_CONTROL_PAUSE:
+		case SERVICE_CONTROL_CONTINUE:
+		case SERVICE_CONTROL_INTERROGATE:
+		case SERVICE_CONTROL_POWEREVENT:
+		case SERVICE_CONTROL_SESSIONCHANGE:
+		case SERVICE_CONTROL_DEVICEEVENT:
+			return NO_ERROR;
+
+		default:
+			return ERROR_CALL_NOT_IMPLEMENTED;
+	}
+}
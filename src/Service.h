@@ -2,8 +2,29 @@
 #include <Windows.h>
 #include <stdint.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "CommandChannel.h"
+#include "ControlTrace.h"
+#include "CpuAccount.h"
+#include "EventBus.h"
+#include "FairScheduler.h"
+#include "Journal.h"
+#include "PauseGate.h"
+#include "ServiceMemory.h"
+#include "SharedRing.h"
+#include "Snapshot.h"
+#include "TimerWheel.h"
+#include "WaitHint.h"
+#include "Watchdog.h"
 #include "service_sm.h"
 
 class SCMDispatcher;
@@ -14,10 +35,27 @@ public:
 	struct config {
 		LPSERVICE_MAIN_FUNCTIONW function_main;
 		LPHANDLER_FUNCTION function_handler;
+		LPHANDLER_FUNCTION_EX function_handler_ex;	// preferred over function_handler when set
 		SERVICE_STATUS status;
 		SERVICE_STATUS_HANDLE status_handle;
 		HANDLE stop_event;
 		DWORD accepted_controls;
+		DWORD drain_timeout;  // ms to wait for the workers on stop, 0 for the default
+		DWORD pause_timeout;  // ms to wait for the pausable workers to park, 0 for the default
+		LPCWSTR command_pipe;  // serve `commands` on \\.\pipe\<command_pipe> while running
+		LPCWSTR snapshot_path;	// warm restart state file, save() on stop and load() on start when set
+		DWORD snapshot_version;	// of the saved state, a snapshot of another version is discarded
+		LPCWSTR journal_path;	// journal of the state transitions of the service process when set
+		struct {
+			GROUP_AFFINITY affinity;  // processors of the framework threads, a 0 mask for any
+			USHORT numa_node;		  // processors of the node, when numa is set and the mask is 0
+			bool numa;
+			int priority;  // THREAD_PRIORITY_*, 0 is normal
+		} placement;
+		struct {
+			TaskClass task_class;  // of the submitted tasks, 0 is normal
+			uint32_t weight;	   // share of the scheduler against the services of the class, 0 for 1
+		} scheduling;
 		struct {
 			LPCWSTR lpServiceName;
 			LPCWSTR lpDisplayName;
@@ -37,19 +75,177 @@ public:
 	virtual bool run();
 	virtual bool stop();
 
+	// ms the last stop took from the stop request until the workers drained
+	DWORD shutdown_latency() const
+	{
+		return m_ShutdownLatency;
+	}
+
+	// CPU time the framework threads of the service spent in a lifecycle phase, over all the runs
+	CpuAccount::Times cpu_time(CpuAccount::Phase phase)
+	{
+		return m_Cpu.get(phase);
+	}
+
+	// Bytes in use by the memory of the service, and the most it used
+	size_t memory_live() const
+	{
+		return memory.live();
+	}
+
+	size_t memory_peak() const
+	{
+		return memory.peak();
+	}
+
+	// ms the last start took until running, and whether it loaded a snapshot
+	DWORD ready_latency() const
+	{
+		return m_ReadyLatency;
+	}
+
+	bool warm_started() const
+	{
+		return m_WarmStarted;
+	}
+
+	// ms the last pause took until the pausable workers parked, and the longest one
+	DWORD quiesce_latency() const
+	{
+		return m_QuiesceLatency;
+	}
+
+	DWORD max_quiesce_latency() const
+	{
+		return m_MaxQuiesceLatency;
+	}
+
+	// Tasks run for the service by the shared scheduler and their queueing delay, of the current run
+	FairScheduler::Metrics task_metrics() const
+	{
+		auto tasks = m_Tasks.load();
+		return tasks ? tasks->metrics() : FairScheduler::Metrics{};
+	}
+
+	// Record the received controls and the reported statuses, nullptr stops the recording
+	void record(std::shared_ptr<ControlTrace> trace)
+	{
+		m_Trace.store(std::move(trace));
+	}
+
 protected:	// access by derived
 	config cfg{0};
 	ServiceStateMachine s;
+	Watchdog watchdog;
+	EventBus events;  // power, session and device events, requires function_handler_ex
+	CommandServer commands;
+	TimerWheel timers;	// turns while running, suspended while paused
+	ServiceMemory memory;  // startup() and pool() std::pmr resources, released when the service stops
+
+	// Cancellation of the current run, requested when the service stops
+	std::stop_token stop_token() const
+	{
+		return m_StopSource.get_token();
+	}
+
+	// ms the stop waits for the workers, a stop() override bounds its own waits by it
+	DWORD drain_timeout() const
+	{
+		return cfg.drain_timeout ? cfg.drain_timeout : default_drain_timeout;
+	}
+
+	// What the journal held when the service process started, valid from the start() override
+	const Journal::Recovery& recovery() const
+	{
+		return m_Journal.recovery();
+	}
+
+	// Start a service owned worker, the service drains it on stop.
+	// A pausable worker must reach checkpoint() regularly, the service is paused once all of them
+	// parked, `wake` releases the worker from a blocking wait so it reaches its checkpoint.
+	void spawn(std::function<void(std::stop_token)> worker,
+			   bool pausable			  = false,
+			   std::function<void()> wake = {});
+
+	// Run a short task on the scheduler shared by the services of the process, under cfg.scheduling.
+	// False when the service isn't running. The tasks run while paused too, stop drops the pending
+	// ones and waits for the running ones with the workers
+	bool submit(FairScheduler::task_t task);
+
+	// Park the calling pausable worker while the service is paused
+	inline void checkpoint()
+	{
+		m_Gate.checkpoint();
+	}
+
+	// Create a shared memory ring and consume it on a service worker until stop,
+	// the producers block on a full ring while paused. Call from the start() override.
+	// `sddl` selects the clients allowed to open the ring
+	bool attach_ring(std::wstring_view name,
+					 RingConsumer::handler_t handler,
+					 uint32_t capacity = 4096,
+					 uint32_t slotSize = 256,
+					 RingMode mode	   = RingMode::mpsc,
+					 LPCWSTR sddl	   = SharedRing::default_sddl);
 
 private:
+	static constexpr DWORD default_drain_timeout = 30000;
+	static constexpr DWORD default_pause_timeout = 10000;
+	// ms between the stop and pause pending reports, twice per the shortest wait hint
+	static constexpr DWORD drain_checkpoint = WaitHint::min_hint / 2;
+
+	// Under m_WorkersMtx, a worker that missed the drain deadline is detached and counted until it exits
+	struct WorkerState {
+		bool done	  = false;
+		bool detached = false;
+	};
+
+	struct Worker {
+		std::thread thread;
+		std::shared_ptr<WorkerState> state;
+	};
+
+	std::stop_source m_StopSource;
+	std::mutex m_WorkersMtx;
+	std::condition_variable m_WorkersCv;
+	std::vector<Worker> m_Workers;
+	std::vector<std::function<void()>> m_Wakers;  // of the pausable workers
+	uint32_t m_ActiveWorkers   = 0;
+	uint32_t m_DetachedWorkers = 0;
+	DWORD m_ShutdownLatency  = 0;
+
+	PauseGate m_Gate;
+	HANDLE m_ControlEvent = NULL;  // pause and continue controls for the idle thread
+	std::atomic<DWORD> m_PendingControl{0};
+	DWORD m_QuiesceLatency	  = 0;
+	DWORD m_MaxQuiesceLatency = 0;
+
+	std::atomic<std::shared_ptr<ControlTrace>> m_Trace;
+	std::atomic<std::shared_ptr<FairScheduler::Queue>> m_Tasks;	 // of the current run
+
+	CpuAccount m_Cpu;
+	Journal m_Journal;
+	SnapshotReader m_Snapshot;	// mapped while running, the loaded state may be used in place
+	DWORD m_ReadyLatency = 0;
+	bool m_WarmStarted	 = false;
+	WaitHint m_WaitHint;  // of the pending states, learned over the runs
+
 	DWORD m_Checkpoint = 0;
 	SC_HANDLE m_Handle = NULL;
 	std::wstring m_BinaryPath;
+	DWORD m_ExitCode = NO_ERROR;  // reported with SERVICE_STOPPED
 
 	void update_status(DWORD state, DWORD exitCode, DWORD waitHint);
+	bool create_events();
+	void close_events();
 	bool is_installed();
 	SC_HANDLE get_handle();
 	void idle();
+	void place();
+	void escalate(const Watchdog::Heartbeat& heartbeat);
+	bool drain(ULONGLONG deadline);
+	bool detach_tasks(ULONGLONG deadline);
+	bool quiesce(ULONGLONG deadline);
 
 	// derived can override without calling it directly
 	// base will call it
@@ -57,11 +253,19 @@ private:
 	virtual bool pause();
 	virtual bool resume();
 
+	// Warm restart, called when cfg.snapshot_path is set.
+	// save() runs after the workers drained, allocate the state in the snapshot and fill it,
+	// false to skip it. load() runs before start(), the state is valid until the service stops.
+	virtual bool save(SnapshotWriter& snapshot);
+	virtual void load(std::span<const uint8_t> state);
+
 	// overriding this will not called through the base
 	virtual bool install(); // TODO: Move to overriden section
 	virtual bool uninstall();
 	virtual void __stdcall main(DWORD argc, LPWSTR* argv);
 	virtual void __stdcall handler(DWORD control);
+	virtual DWORD __stdcall handler_ex(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context);
 
 	friend SCMDispatcher;
+	friend ControlReplayer;
 };
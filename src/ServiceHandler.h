@@ -281,12 +281,13 @@ private:
 			case SERVICE_CONTINUE_PENDING:
 			case SERVICE_PAUSE_PENDING:
 				while (status.dwCurrentState == state) {
-					// Bound the 10th of hint between 1 - 10 seconds
+					// Bound the 10th of hint between 100 ms - 10 seconds, the framework services
+					// report learned hints and a fast transition is seen within a short poll
 					wait = status.dwWaitHint / 10;
 					if (wait > 10000) {
 						wait = 10000;
-					} else if (wait < 1000) {
-						wait = 1000;
+					} else if (wait < 100) {
+						wait = 100;
 					}
 
 					Sleep(wait);
@@ -0,0 +1,85 @@
+#include "ServiceMemory.h"
+
+#include <new>
+
+namespace
+{
+// HeapAlloc alignment, larger alignments are padded and keep the block start before the pointer
+constexpr size_t heap_alignment = MEMORY_ALLOCATION_ALIGNMENT;
+
+size_t padded(size_t bytes, size_t alignment)
+{
+	return alignment <= heap_alignment ? bytes : bytes + alignment;
+}
+}  // namespace
+
+ServiceMemory::~ServiceMemory()
+{
+	// The arenas release into the heap before it is destroyed
+	m_Pool.release();
+	m_Startup.release();
+}
+
+void ServiceMemory::release()
+{
+	m_Pool.release();
+	m_Startup.release();
+	m_Heap.reset();	 // What the users didn't return to the pool
+}
+
+ServiceMemory::HeapResource::HeapResource()
+{
+	m_Heap = HeapCreate(0, 0, 0);  // serialized, growable
+}
+
+ServiceMemory::HeapResource::~HeapResource()
+{
+	if (m_Heap) {
+		HeapDestroy(m_Heap);
+	}
+}
+
+void ServiceMemory::HeapResource::reset()
+{
+	if (m_Heap) {
+		HeapDestroy(m_Heap);
+	}
+	m_Heap = HeapCreate(0, 0, 0);
+
+	live.store(0, std::memory_order_relaxed);
+}
+
+void* ServiceMemory::HeapResource::do_allocate(size_t bytes, size_t alignment)
+{
+	auto size  = padded(bytes, alignment);
+	auto block = m_Heap ? static_cast<uint8_t*>(HeapAlloc(m_Heap, 0, size)) : nullptr;
+	if (!block) {
+		throw std::bad_alloc();
+	}
+
+	auto current = live.fetch_add(size, std::memory_order_relaxed) + size;
+	auto highest = peak.load(std::memory_order_relaxed);
+	while (current > highest && !peak.compare_exchange_weak(highest, current, std::memory_order_relaxed)) {
+	}
+
+	if (alignment <= heap_alignment) {
+		return block;
+	}
+
+	// At least heap_alignment bytes before the aligned pointer hold the block start
+	auto aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(block) + alignment) & ~(alignment - 1));
+	reinterpret_cast<void**>(aligned)[-1] = block;
+	return aligned;
+}
+
+void ServiceMemory::HeapResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	auto block = alignment <= heap_alignment ? p : reinterpret_cast<void**>(p)[-1];
+	HeapFree(m_Heap, 0, block);
+	live.fetch_sub(padded(bytes, alignment), std::memory_order_relaxed);
+}
+
+bool ServiceMemory::HeapResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
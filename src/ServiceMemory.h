@@ -0,0 +1,70 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory_resource>
+
+// Memory of a single service on its own heap, so a service can't fragment the heap of the others
+// in a shared process and its usage can be told apart.
+// The startup arena is monotonic, for data built once by the start() override on its thread.
+// The pool is synchronized, for the steady state of the workers.
+// Both are released with the heap when the service stops, memory taken from them must not outlive the run.
+class ServiceMemory
+{
+public:
+	ServiceMemory() = default;
+	~ServiceMemory();
+
+	ServiceMemory(const ServiceMemory&)			   = delete;
+	ServiceMemory& operator=(const ServiceMemory&) = delete;
+
+	std::pmr::memory_resource* startup()
+	{
+		return &m_Startup;
+	}
+
+	std::pmr::memory_resource* pool()
+	{
+		return &m_Pool;
+	}
+
+	// Bytes taken from the heap by the arenas, including their bookkeeping
+	size_t live() const
+	{
+		return m_Heap.live.load(std::memory_order_relaxed);
+	}
+
+	size_t peak() const
+	{
+		return m_Heap.peak.load(std::memory_order_relaxed);
+	}
+
+	// Drop everything allocated so far at once, the peak is kept across the runs
+	void release();
+
+private:
+	// Private heap with byte accounting, upstream of the arenas
+	class HeapResource : public std::pmr::memory_resource
+	{
+	public:
+		HeapResource();
+		~HeapResource();
+
+		void reset();
+
+		std::atomic<size_t> live{0};
+		std::atomic<size_t> peak{0};
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+		HANDLE m_Heap = NULL;
+	};
+
+	HeapResource m_Heap;  // first, the arenas release into it
+	std::pmr::monotonic_buffer_resource m_Startup{&m_Heap};
+	std::pmr::synchronized_pool_resource m_Pool{&m_Heap};
+};
@@ -0,0 +1,276 @@
+#include "ServicePoller.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+bool query(SC_HANDLE handle, SERVICE_STATUS_PROCESS& status)
+{
+	DWORD size = 0;
+	return QueryServiceStatusEx(handle,
+								SC_STATUS_PROCESS_INFO,
+								reinterpret_cast<LPBYTE>(&status),
+								sizeof(status),
+								&size);
+}
+
+bool is_pending(DWORD state)
+{
+	return state == SERVICE_START_PENDING || state == SERVICE_STOP_PENDING ||
+		   state == SERVICE_CONTINUE_PENDING || state == SERVICE_PAUSE_PENDING;
+}
+
+std::future<bool> ready(bool result)
+{
+	std::promise<bool> promise;
+	promise.set_value(result);
+	return promise.get_future();
+}
+}  // namespace
+
+ServicePoller::ServicePoller()
+{
+	m_SCM = OpenSCManagerW(NULL,				  // local machine
+						   NULL,				  // local database
+						   SC_MANAGER_CONNECT);	  // access required
+
+	if (!m_SCM) {
+		// log.error("OpenSCManagerW failed (%d)\n", GetLastError());
+	}
+
+	m_Poller = std::jthread([this](std::stop_token token) { run(token); });
+}
+
+ServicePoller::~ServicePoller()
+{
+	m_Poller.request_stop();
+	if (m_Poller.joinable()) {
+		m_Poller.join();
+	}
+
+	for (auto& op : m_Pending) {
+		op->promise.set_value(false);
+		CloseServiceHandle(op->handle);
+	}
+
+	if (m_SCM) {
+		CloseServiceHandle(m_SCM);
+	}
+}
+
+void ServicePoller::on_complete(callback_t callback)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_OnComplete = std::move(callback);
+}
+
+std::future<bool> ServicePoller::start(std::wstring_view name)
+{
+	return submit(name, SERVICE_RUNNING, false);
+}
+
+std::future<bool> ServicePoller::stop(std::wstring_view name)
+{
+	return submit(name, SERVICE_STOPPED, false);
+}
+
+std::future<bool> ServicePoller::restart(std::wstring_view name)
+{
+	return submit(name, SERVICE_RUNNING, true);
+}
+
+size_t ServicePoller::pending()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	return m_Pending.size();
+}
+
+std::future<bool> ServicePoller::submit(std::wstring_view name, DWORD target, bool restart)
+{
+	if (!m_SCM) {
+		return ready(false);
+	}
+
+	SC_HANDLE handle = OpenServiceW(m_SCM,
+									std::wstring(name).c_str(),
+									SERVICE_QUERY_STATUS | SERVICE_START | SERVICE_STOP);
+
+	SERVICE_STATUS_PROCESS status;
+	if (!handle || !query(handle, status)) {
+		// log.error("Cannot open service %ls (%d)\n", name.data(), GetLastError());
+		if (handle) {
+			CloseServiceHandle(handle);
+		}
+		return ready(false);
+	}
+
+	auto op				   = std::make_unique<Operation>();
+	op->name			   = name;
+	op->handle			   = handle;
+	op->target			   = target;
+	op->start_when_stopped = false;
+
+	bool sent  = true;
+	auto state = status.dwCurrentState;
+
+	if (target == SERVICE_RUNNING && state == SERVICE_STOPPED) {
+		sent = StartServiceW(handle, 0, NULL);
+	} else if (target == SERVICE_RUNNING && (restart || state == SERVICE_STOP_PENDING)) {
+		// Wait for the stop and start it from the poller
+		if (state != SERVICE_STOP_PENDING) {
+			SERVICE_STATUS stopped;
+			sent = ControlService(handle, SERVICE_CONTROL_STOP, &stopped);
+		}
+		op->target			   = SERVICE_STOPPED;
+		op->start_when_stopped = true;
+	} else if (target == SERVICE_STOPPED && state != SERVICE_STOPPED && state != SERVICE_STOP_PENDING) {
+		SERVICE_STATUS stopped;
+		sent = ControlService(handle, SERVICE_CONTROL_STOP, &stopped);
+	} else if (state == target || !is_pending(state)) {
+		CloseServiceHandle(handle);
+		return ready(true);	 // already there, a paused service is already started
+	}
+
+	if (!sent) {
+		// log.error("Cannot control service %ls (%d)\n", name.data(), GetLastError());
+		CloseServiceHandle(handle);
+		return ready(false);
+	}
+
+	auto future = op->promise.get_future();
+	follow(std::move(op), status.dwWaitHint);
+	return future;
+}
+
+void ServicePoller::follow(std::unique_ptr<Operation> op, DWORD waitHint)
+{
+	auto now	  = GetTickCount64();
+	op->progress  = now;
+	op->next_poll = now + std::clamp<DWORD>(waitHint / 10, min_poll, max_poll);
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Pending.push_back(std::move(op));
+	m_Submitted++;
+	m_Cv.notify_one();
+}
+
+bool ServicePoller::poll(Operation& op, ULONGLONG now, Completion& completion)
+{
+	auto& status		 = completion.status;
+	completion.name		 = op.name;
+	completion.succeeded = false;
+
+	if (!query(op.handle, status)) {
+		return true;
+	}
+
+	if (status.dwCurrentState == op.target) {
+		if (!op.start_when_stopped) {
+			completion.succeeded = true;
+			return true;
+		}
+
+		// The stop part of a restart is over
+		if (!StartServiceW(op.handle, 0, NULL)) {
+			return true;
+		}
+
+		op.target			  = SERVICE_RUNNING;
+		op.start_when_stopped = false;
+		op.checkpoint		  = 0;
+		op.progress			  = now;
+		op.next_poll		  = now + min_poll;
+		return false;
+	}
+
+	if (!is_pending(status.dwCurrentState)) {
+		return true;  // settled in another state, the start failed
+	}
+
+	// Bound the 10th of hint like ServiceHandler::wait_pending, and fail a service that stopped progressing
+	if (status.dwCheckPoint != op.checkpoint) {
+		op.checkpoint = status.dwCheckPoint;
+		op.progress	  = now;
+	} else if (now - op.progress > std::max<DWORD>(status.dwWaitHint, min_poll)) {
+		// log.error("Timeout waiting for %ls\n", op.name.c_str());
+		return true;
+	}
+
+	op.next_poll = now + std::clamp<DWORD>(status.dwWaitHint / 10, min_poll, max_poll);
+	return false;
+}
+
+void ServicePoller::run(std::stop_token token)
+{
+	std::vector<Operation*> due;
+	std::vector<Completion> completions;
+	std::vector<std::unique_ptr<Operation>> completed;
+
+	std::unique_lock<std::mutex> lock(m_Mtx);
+
+	while (!token.stop_requested()) {
+		if (m_Pending.empty()) {
+			m_Cv.wait(lock, token, [this] { return !m_Pending.empty(); });
+			continue;
+		}
+
+		// Sleep until the first operation is due, a new one may be due earlier
+		auto now	   = GetTickCount64();
+		auto next_poll = (*std::min_element(m_Pending.begin(), m_Pending.end(), [](auto& a, auto& b) {
+							 return a->next_poll < b->next_poll;
+						 }))->next_poll;
+
+		if (next_poll > now) {
+			auto submitted = m_Submitted;
+			m_Cv.wait_for(lock, token, std::chrono::milliseconds(next_poll - now), [&] {
+				return m_Submitted != submitted;
+			});
+			continue;
+		}
+
+		// Only this thread removes operations, the pointers stay valid while unlocked
+		due.clear();
+		for (auto& op : m_Pending) {
+			if (op->next_poll <= now) {
+				due.push_back(op.get());
+			}
+		}
+
+		lock.unlock();
+		completions.clear();
+		for (auto op : due) {
+			Completion completion;
+			if (poll(*op, now, completion)) {
+				op->next_poll = 0;	// marks it completed
+				completions.push_back(std::move(completion));
+			} else {
+				op->next_poll = std::max(op->next_poll, now + 1);
+			}
+		}
+		lock.lock();
+
+		completed.clear();
+		std::erase_if(m_Pending, [&](auto& op) {
+			if (op->next_poll) {
+				return false;
+			}
+			completed.push_back(std::move(op));
+			return true;
+		});
+		auto callback = m_OnComplete;
+		lock.unlock();
+
+		// Deliver the batch out of the lock, a callback may submit operations.
+		// Both are in the pending order, the completions of this round only
+		for (size_t i = 0; i < completed.size(); i++) {
+			CloseServiceHandle(completed[i]->handle);
+			completed[i]->promise.set_value(completions[i].succeeded);
+		}
+
+		if (callback && !completions.empty()) {
+			callback(completions);
+		}
+		lock.lock();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous start, stop and restart of SCM owned services.
+// The control is sent on the calling thread, a single poller thread then follows the services still
+// pending, each one at a tenth of its wait hint, and completes the ones that settled in a batch.
+class ServicePoller
+{
+public:
+	struct Completion {
+		std::wstring name;
+		SERVICE_STATUS_PROCESS status;	// the last queried status
+		bool succeeded;
+	};
+
+	using callback_t = std::function<void(std::span<const Completion> completions)>;
+
+	ServicePoller();
+	~ServicePoller();
+
+	ServicePoller(const ServicePoller&)			   = delete;
+	ServicePoller& operator=(const ServicePoller&) = delete;
+
+	// Called on the poller thread with each batch, in addition to the futures.
+	// Set before the first operation
+	void on_complete(callback_t callback);
+
+	// Unlike ServiceHandler::stop the dependent services are not stopped,
+	// the stop fails while they are running
+	std::future<bool> start(std::wstring_view name);
+	std::future<bool> stop(std::wstring_view name);
+	std::future<bool> restart(std::wstring_view name);
+
+	size_t pending();
+
+private:
+	static constexpr DWORD min_poll = 100;	// ms
+	static constexpr DWORD max_poll = 10000;
+
+	struct Operation {
+		std::wstring name;
+		SC_HANDLE handle;
+		DWORD target;				// SERVICE_RUNNING or SERVICE_STOPPED
+		bool start_when_stopped;	// a restart, or a start of a service still stopping
+		DWORD checkpoint	= 0;
+		ULONGLONG progress	= 0;  // tick of the last checkpoint change
+		ULONGLONG next_poll = 0;
+		std::promise<bool> promise;
+	};
+
+	std::future<bool> submit(std::wstring_view name, DWORD target, bool restart);
+	void follow(std::unique_ptr<Operation> op, DWORD waitHint);
+	void run(std::stop_token token);
+
+	// False while the operation is pending
+	bool poll(Operation& op, ULONGLONG now, Completion& completion);
+
+	SC_HANDLE m_SCM = NULL;
+	callback_t m_OnComplete;
+
+	std::mutex m_Mtx;
+	std::condition_variable_any m_Cv;
+	std::vector<std::unique_ptr<Operation>> m_Pending;
+	uint32_t m_Submitted = 0;  // wakes the poller for an operation due before its next poll
+	std::jthread m_Poller;	// last, started after everything else is constructed
+};
@@ -0,0 +1,135 @@
+#include "ServiceRegistry.h"
+
+#include <algorithm>
+
+#include "Service.h"
+
+std::atomic<ServiceRegistry::Hazard*> ServiceRegistry::s_Hazards{nullptr};
+
+namespace
+{
+// Frees the slot of the thread when it exits
+struct HazardHolder {
+	std::atomic<bool>* owned = nullptr;
+
+	~HazardHolder()
+	{
+		if (owned) {
+			owned->store(false, std::memory_order_release);
+		}
+	}
+};
+}  // namespace
+
+ServiceRegistry::ServiceRegistry() : m_Current(new map_t) {}
+
+ServiceRegistry::~ServiceRegistry()
+{
+	delete m_Current.load(std::memory_order_relaxed);
+}
+
+ServiceRegistry::Hazard* ServiceRegistry::hazard()
+{
+	thread_local Hazard* local = nullptr;
+	thread_local HazardHolder holder;
+
+	if (local) {
+		return local;
+	}
+
+	// Reuse the slot of an exited thread
+	for (auto slot = s_Hazards.load(std::memory_order_acquire); slot; slot = slot->next) {
+		bool owned = false;
+		if (!slot->owned.load(std::memory_order_relaxed) &&
+			slot->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+			local = slot;
+			break;
+		}
+	}
+
+	if (!local) {
+		local = new Hazard;
+		local->owned.store(true, std::memory_order_relaxed);
+		local->next = s_Hazards.load(std::memory_order_relaxed);
+		while (!s_Hazards.compare_exchange_weak(local->next, local, std::memory_order_release)) {
+		}
+	}
+
+	holder.owned = &local->owned;
+	return local;
+}
+
+ServiceRegistry::ReadSection::ReadSection(const ServiceRegistry& registry) : m_Hazard(hazard())
+{
+	// Announce, then check the map is still current, a writer retiring it after sees the hazard
+	auto map = registry.m_Current.load(std::memory_order_seq_cst);
+	do {
+		m_Map = map;
+		m_Hazard->map.store(m_Map, std::memory_order_seq_cst);
+		map = registry.m_Current.load(std::memory_order_seq_cst);
+	} while (map != m_Map);
+}
+
+std::shared_ptr<Service> ServiceRegistry::find(std::wstring_view name) const
+{
+	ReadSection map(*this);
+	auto it = map->find(name);
+	return it == map->end() ? nullptr : it->second;
+}
+
+size_t ServiceRegistry::size() const
+{
+	ReadSection map(*this);
+	return map->size();
+}
+
+std::vector<ServiceRegistry::entry_t> ServiceRegistry::snapshot() const
+{
+	ReadSection map(*this);
+	return {map->begin(), map->end()};
+}
+
+bool ServiceRegistry::insert(std::wstring_view name, std::shared_ptr<Service> svc)
+{
+	std::lock_guard<std::mutex> g(m_WriteMtx);
+	auto current = m_Current.load(std::memory_order_relaxed);
+	if (current->contains(name)) {
+		return false;
+	}
+
+	auto next = std::make_unique<map_t>(*current);
+	next->emplace(name, std::move(svc));
+	publish(std::move(next));
+	return true;
+}
+
+bool ServiceRegistry::erase(std::wstring_view name)
+{
+	std::lock_guard<std::mutex> g(m_WriteMtx);
+	auto current = m_Current.load(std::memory_order_relaxed);
+	if (!current->contains(name)) {
+		return false;
+	}
+
+	auto next = std::make_unique<map_t>(*current);
+	next->erase(name);
+	publish(std::move(next));
+	return true;
+}
+
+void ServiceRegistry::publish(std::unique_ptr<map_t> next)
+{
+	// A reader announcing after the exchange sees the new map and retries
+	m_Retired.emplace_back(m_Current.exchange(next.release(), std::memory_order_seq_cst));
+
+	std::vector<const map_t*> held;
+	for (auto slot = s_Hazards.load(std::memory_order_acquire); slot; slot = slot->next) {
+		if (auto map = slot->map.load(std::memory_order_seq_cst)) {
+			held.push_back(map);
+		}
+	}
+
+	std::erase_if(m_Retired, [&held](const std::unique_ptr<map_t>& map) {
+		return std::find(held.begin(), held.end(), map.get()) == held.end();
+	});
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Service;
+
+// Services by name, read from the SCM threads while services are added and removed at runtime.
+// A lookup never waits, the writers copy the map and publish the copy. A lookup announces the map it
+// reads in a hazard slot of its thread, a write frees the replaced maps no slot holds, so at most one
+// map per reading thread stays retired. A looked up service lives on by its shared_ptr.
+class ServiceRegistry
+{
+public:
+	using map_t	  = std::map<std::wstring_view, std::shared_ptr<Service>>;
+	using entry_t = std::pair<std::wstring_view, std::shared_ptr<Service>>;
+
+	ServiceRegistry();
+	~ServiceRegistry();
+
+	ServiceRegistry(const ServiceRegistry&)			   = delete;
+	ServiceRegistry& operator=(const ServiceRegistry&) = delete;
+
+	std::shared_ptr<Service> find(std::wstring_view name) const;
+
+	bool contains(std::wstring_view name) const
+	{
+		return find(name) != nullptr;
+	}
+
+	size_t size() const;
+
+	// The services at the time of the call, for iterating without holding up the writers
+	std::vector<entry_t> snapshot() const;
+
+	// The name must outlive the entry, false if it is taken
+	bool insert(std::wstring_view name, std::shared_ptr<Service> svc);
+	bool erase(std::wstring_view name);
+
+private:
+	// Process wide, a thread claims a free slot on its first lookup and frees it when it exits.
+	// Slots are never deleted, the list only grows to the peak number of reading threads
+	struct alignas(64) Hazard {
+		std::atomic<const map_t*> map{nullptr};
+		std::atomic<bool> owned{false};
+		Hazard* next = nullptr;
+	};
+
+	// Lock free, keeps the map it returns from being freed until destruction
+	class ReadSection
+	{
+	public:
+		ReadSection(const ServiceRegistry& registry);
+
+		~ReadSection()
+		{
+			m_Hazard->map.store(nullptr, std::memory_order_release);
+		}
+
+		const map_t* operator->() const
+		{
+			return m_Map;
+		}
+
+	private:
+		Hazard* m_Hazard;
+		const map_t* m_Map;
+	};
+
+	static Hazard* hazard();  // of the calling thread
+	void publish(std::unique_ptr<map_t> next);
+
+	static std::atomic<Hazard*> s_Hazards;
+
+	std::atomic<map_t*> m_Current;
+	std::mutex m_WriteMtx;
+	std::vector<std::unique_ptr<map_t>> m_Retired;	// replaced, freed when no hazard holds them
+};
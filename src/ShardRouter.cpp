@@ -0,0 +1,62 @@
+#include "ShardRouter.h"
+
+#include <algorithm>
+
+ShardRouter::ShardRouter(std::wstring_view name, uint32_t shards, uint32_t replicas)
+	: m_Name(name), m_Shards(shards)
+{
+	m_Ring.reserve(static_cast<size_t>(shards) * replicas);
+
+	for (uint32_t shard = 0; shard < shards; shard++) {
+		// The points depend on the shard name only, not on the number of shards
+		auto id		= shard_name(m_Name, shard);
+		auto points = std::span(reinterpret_cast<const uint8_t*>(id.data()), id.size() * sizeof(wchar_t));
+
+		for (uint32_t replica = 0; replica < replicas; replica++) {
+			m_Ring.emplace_back(hash(points, replica), shard);
+		}
+	}
+
+	std::sort(m_Ring.begin(), m_Ring.end());
+}
+
+std::wstring ShardRouter::shard_name(std::wstring_view name, uint32_t index)
+{
+	return std::wstring(name) + L"_" + std::to_wstring(index);
+}
+
+std::wstring ShardRouter::shard_path(std::wstring_view path, uint32_t index)
+{
+	auto file = path.find_last_of(L"\\/");
+	auto ext  = path.find_last_of(L'.');
+	if (ext == std::wstring_view::npos || (file != std::wstring_view::npos && ext < file) || ext == file + 1) {
+		return shard_name(path, index);	 // no extension, or a dot file
+	}
+
+	return shard_name(path.substr(0, ext), index) + std::wstring(path.substr(ext));
+}
+
+uint32_t ShardRouter::shard(std::span<const uint8_t> key) const
+{
+	if (m_Ring.empty()) {
+		return 0;
+	}
+
+	// The first point clockwise from the key
+	auto point = std::lower_bound(m_Ring.begin(), m_Ring.end(), std::make_pair(hash(key, 0), uint32_t(0)));
+	return point == m_Ring.end() ? m_Ring.front().second : point->second;
+}
+
+uint64_t ShardRouter::hash(std::span<const uint8_t> data, uint64_t seed)
+{
+	// FNV-1a with a final mix, the ring points need to spread even for similar names
+	uint64_t value = 0xCBF29CE484222325ull ^ (seed * 0x9E3779B97F4A7C15ull);
+	for (auto byte : data) {
+		value = (value ^ byte) * 0x100000001B3ull;
+	}
+
+	value ^= value >> 33;
+	value *= 0xFF51AFD7ED558CCDull;
+	value ^= value >> 33;
+	return value;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Consistent hash of keys to the shards of a service, a key moves only when its shard is added or removed.
+// Each shard owns `replicas` points on the ring to even the load.
+class ShardRouter
+{
+public:
+	ShardRouter(std::wstring_view name, uint32_t shards, uint32_t replicas = 64);
+
+	// <name>_<index>, the service name of the shard and the suffix of its command pipe
+	static std::wstring shard_name(std::wstring_view name, uint32_t index);
+
+	// <dir>\<stem>_<index>.<ext>, a file of the shard next to the one named by `path`
+	static std::wstring shard_path(std::wstring_view path, uint32_t index);
+
+	uint32_t shard(std::span<const uint8_t> key) const;
+
+	std::wstring route(std::span<const uint8_t> key) const
+	{
+		return shard_name(m_Name, shard(key));
+	}
+
+	uint32_t size() const
+	{
+		return m_Shards;
+	}
+
+private:
+	static uint64_t hash(std::span<const uint8_t> data, uint64_t seed);
+
+	std::wstring m_Name;
+	uint32_t m_Shards;
+	std::vector<std::pair<uint64_t, uint32_t>> m_Ring;	// sorted points and their shard
+};
@@ -0,0 +1,285 @@
+#include "SharedRing.h"
+
+#include <string.h>
+
+#include <new>
+
+#include "RAII.h"
+
+SharedRing::~SharedRing()
+{
+	unmap();
+}
+
+bool SharedRing::map(std::wstring_view name,
+					 bool create,
+					 uint32_t capacity,
+					 uint32_t slotSize,
+					 RingMode mode,
+					 LPCWSTR sddl)
+{
+	// Global namespace, the service runs in session 0 and the clients in user sessions
+	auto base = L"Global\\" + std::wstring(name);
+
+	unmap();
+
+	if (create) {
+		if (!capacity || (capacity & (capacity - 1)) || !slotSize || slotSize > max_slot) {
+			// log.error("Ring capacity must be a power of 2\n");
+			return false;
+		}
+
+		SecurityAttributes security(sddl);
+		if (!security.get()) {
+			// log.error("Invalid ring SDDL (%d)\n", GetLastError());
+			return false;
+		}
+
+		auto size = sizeof(Header) + capacity * stride(slotSize);
+		m_Mapping = CreateFileMappingW(INVALID_HANDLE_VALUE,		  // paging file
+									   security.get(),				  // clients allowed by the sddl
+									   PAGE_READWRITE,				  // read/write access
+									   static_cast<DWORD>(size >> 32),  // size high
+									   static_cast<DWORD>(size),		  // size low
+									   base.c_str());				  // name of mapping object
+
+		if (m_Mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+			// log.error("Ring %ls already exist\n", base.c_str());
+			unmap();
+			return false;
+		}
+
+		m_Data	= CreateEventW(security.get(), FALSE, FALSE, (base + L"_data").c_str());
+		m_Space = CreateEventW(security.get(), FALSE, FALSE, (base + L"_space").c_str());
+	} else {
+		m_Mapping = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, base.c_str());
+		m_Data	  = OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, (base + L"_data").c_str());
+		m_Space	  = OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, (base + L"_space").c_str());
+	}
+
+	if (!m_Mapping || !m_Data || !m_Space) {
+		// log.error("Cannot map ring %ls (%d)\n", base.c_str(), GetLastError());
+		unmap();
+		return false;
+	}
+
+	if (!create) {
+		// Read the geometry from the header alone, the view of the slots is sized by it
+		auto view	= MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, sizeof(Header));
+		auto header = static_cast<const Header*>(view);
+		if (!header) {
+			unmap();
+			return false;
+		}
+
+		bool valid = header->magic == magic && header->version == version && header->capacity &&
+					 !(header->capacity & (header->capacity - 1)) && header->slot_size &&
+					 header->slot_size <= max_slot;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		capacity = header->capacity;
+		slotSize = header->slot_size;
+		mode	 = header->mode == RingMode::spsc ? RingMode::spsc : RingMode::mpsc;
+		UnmapViewOfFile(header);
+
+		if (!valid) {
+			// log.error("Ring %ls has unexpected layout\n", base.c_str());
+			unmap();
+			return false;
+		}
+	}
+
+	// Fails when the section is smaller than the geometry claims
+	auto size = sizeof(Header) + capacity * stride(slotSize);
+	auto view = static_cast<uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size));
+	if (!view) {
+		unmap();
+		return false;
+	}
+
+	m_Header   = reinterpret_cast<Header*>(view);
+	m_Slots	   = view + sizeof(Header);
+	m_Capacity = capacity;
+	m_SlotSize = slotSize;
+	m_Stride   = stride(slotSize);
+	m_Mode	   = mode;
+
+	if (create) {
+		new (m_Header) Header{};
+		m_Header->version	= version;
+		m_Header->capacity	= capacity;
+		m_Header->slot_size = slotSize;
+		m_Header->mode		= mode;
+
+		for (uint64_t i = 0; i < capacity; i++) {
+			new (&slot(i)->sequence) std::atomic<uint64_t>(i);
+		}
+
+		// Producers validate the magic, publish it last
+		std::atomic_thread_fence(std::memory_order_release);
+		m_Header->magic = magic;
+	}
+
+	return true;
+}
+
+void SharedRing::unmap()
+{
+	if (m_Header) {
+		UnmapViewOfFile(m_Header);
+		m_Header = nullptr;
+		m_Slots	 = nullptr;
+	}
+
+	m_Capacity = 0;
+	m_SlotSize = 0;
+	m_Stride   = 0;
+
+	for (auto handle : {&m_Mapping, &m_Data, &m_Space}) {
+		if (*handle) {
+			CloseHandle(*handle);
+			*handle = NULL;
+		}
+	}
+}
+
+bool RingConsumer::create(std::wstring_view name,
+						  uint32_t capacity,
+						  uint32_t slotSize,
+						  RingMode mode,
+						  LPCWSTR sddl)
+{
+	m_Tail = 0;
+	return map(name, true, capacity, slotSize, mode, sddl);
+}
+
+size_t RingConsumer::consume(const handler_t& handler, size_t maxBatch, DWORD timeout)
+{
+	auto tail	 = m_Tail;
+	size_t count = 0;
+
+	while (count < maxBatch) {
+		auto record = slot(tail + count);
+		if (record->sequence.load(std::memory_order_acquire) != tail + count + 1) {
+			break;
+		}
+
+		// Written by a client, read once and bound by our slot size
+		auto length = *static_cast<volatile uint32_t*>(&record->length);
+		if (length <= m_SlotSize) {
+			handler({record->data, length});
+		} else {
+			// log.warning("Ring record of %d bytes skipped\n", length);
+		}
+		count++;
+	}
+
+	if (!count) {
+		// Announce before the last check, a producer publishing after it sees the flag
+		m_Header->consumer_idle.store(1, std::memory_order_seq_cst);
+		if (!has_data()) {
+			WaitForSingleObject(m_Data, timeout);
+		}
+		m_Header->consumer_idle.store(0, std::memory_order_relaxed);
+		return 0;
+	}
+
+	// Release the whole batch to the producers
+	for (size_t i = 0; i < count; i++) {
+		slot(tail + i)->sequence.store(tail + i + m_Capacity, std::memory_order_release);
+	}
+	m_Tail = tail + count;
+	m_Header->tail.store(m_Tail, std::memory_order_release);
+
+	notify(m_Header->producers_waiting, m_Space);
+	return count;
+}
+
+void RingConsumer::wake()
+{
+	SetEvent(m_Data);
+}
+
+void RingConsumer::run(const handler_t& handler, std::stop_token token, size_t maxBatch)
+{
+	std::stop_callback onStop(token, [this] { wake(); });
+
+	while (!token.stop_requested()) {
+		consume(handler, maxBatch, INFINITE);
+	}
+}
+
+bool RingProducer::open(std::wstring_view name)
+{
+	return map(name, false, 0, 0, RingMode::mpsc);
+}
+
+bool RingProducer::try_push(std::span<const uint8_t> record)
+{
+	if (record.size() > m_SlotSize) {
+		return false;
+	}
+
+	auto head = m_Header->head.load(std::memory_order_relaxed);
+	Slot* reserved;
+
+	while (true) {
+		reserved  = slot(head);
+		auto diff = static_cast<int64_t>(reserved->sequence.load(std::memory_order_acquire) - head);
+		if (diff < 0) {
+			return false;  // full, the consumer hasn't released this slot yet
+		}
+
+		if (diff > 0) {
+			head = m_Header->head.load(std::memory_order_relaxed);	// another producer took it
+		} else if (m_Mode == RingMode::spsc) {
+			m_Header->head.store(head + 1, std::memory_order_relaxed);
+			break;
+		} else if (m_Header->head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	memcpy(reserved->data, record.data(), record.size());
+	reserved->length = static_cast<uint32_t>(record.size());
+	reserved->sequence.store(head + 1, std::memory_order_release);
+
+	notify(m_Header->consumer_idle, m_Data);
+	return true;
+}
+
+bool RingProducer::push(std::span<const uint8_t> record, DWORD timeout)
+{
+	auto start = GetTickCount64();
+
+	bool waited = false;
+
+	while (!try_push(record)) {
+		if (record.size() > m_SlotSize) {
+			return false;
+		}
+
+		auto elapsed = GetTickCount64() - start;
+		if (timeout != INFINITE && elapsed >= timeout) {
+			return false;
+		}
+
+		// Announce before the last check, the consumer releasing after it sees the waiter.
+		// The event is auto reset, a release wakes a single producer and a set event is never lost
+		m_Header->producers_waiting.fetch_add(1, std::memory_order_seq_cst);
+		if (!has_space()) {
+			WaitForSingleObject(m_Space, timeout == INFINITE ? INFINITE : static_cast<DWORD>(timeout - elapsed));
+			waited = true;
+		}
+		m_Header->producers_waiting.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Pass the wake on to the next waiting producer while there is space for it
+	if (waited) {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_Header->producers_waiting.load(std::memory_order_relaxed) && has_space()) {
+			SetEvent(m_Space);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <span>
+#include <stop_token>
+#include <string>
+
+// Bounded ring of fixed size records in a named shared memory section.
+// Producers (clients) push records, a single consumer (the service) reads them in batches.
+// Each slot carries a sequence number, a slot is published by its sequence, therefore
+// multiple producers may reserve slots concurrently.
+// Sides sleep on a named event only when they are idle, a busy ring never enters the kernel.
+// Each side keeps the geometry it created or validated, the shared header isn't trusted after that.
+
+enum class RingMode : uint32_t {
+	spsc = 0,  // single producer, reserve with a plain store
+	mpsc	   // multiple producers, reserve with a CAS
+};
+
+class SharedRing
+{
+public:
+	static constexpr uint32_t magic	  = 0x474E4952;  // RING
+	static constexpr uint32_t version = 1;
+	static constexpr uint32_t max_slot = 64 * 1024;
+
+	// SYSTEM, the administrators, the account of the service and the interactive users
+	static constexpr LPCWSTR default_sddl = L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;GRGWGX;;;IU)";
+
+	SharedRing() = default;
+	~SharedRing();
+
+	SharedRing(const SharedRing&)			 = delete;
+	SharedRing& operator=(const SharedRing&) = delete;
+
+	uint32_t slot_size() const
+	{
+		return m_SlotSize;
+	}
+
+protected:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t capacity;	// slots, power of 2
+		uint32_t slot_size;
+		RingMode mode;
+
+		alignas(64) std::atomic<uint64_t> head;				  // next slot to reserve
+		alignas(64) std::atomic<uint64_t> tail;				  // next slot to consume
+		alignas(64) std::atomic<uint32_t> consumer_idle;	  // consumer waits on the data event
+		alignas(64) std::atomic<uint32_t> producers_waiting;  // producers wait on the space event
+	};
+
+	struct Slot {
+		std::atomic<uint64_t> sequence;
+		uint32_t length;
+		uint32_t reserved;
+		uint8_t data[1];
+	};
+
+	static constexpr uint32_t slot_header = offsetof(Slot, data);
+
+	static size_t stride(uint32_t slotSize)
+	{
+		return (slot_header + slotSize + 63) & ~size_t(63);	 // a slot per cache line(s)
+	}
+
+	bool map(std::wstring_view name,
+			 bool create,
+			 uint32_t capacity,
+			 uint32_t slotSize,
+			 RingMode mode,
+			 LPCWSTR sddl = default_sddl);
+	void unmap();
+
+	inline Slot* slot(uint64_t position)
+	{
+		return reinterpret_cast<Slot*>(m_Slots + (position & (m_Capacity - 1)) * m_Stride);
+	}
+
+	// Wake the other side only if it announced it is idle
+	inline void notify(std::atomic<uint32_t>& idle, HANDLE event)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (idle.load(std::memory_order_relaxed)) {
+			SetEvent(event);
+		}
+	}
+
+	inline bool has_space()
+	{
+		auto head = m_Header->head.load(std::memory_order_seq_cst);
+		return slot(head)->sequence.load(std::memory_order_seq_cst) == head;
+	}
+
+	Header* m_Header	= nullptr;
+	uint8_t* m_Slots	= nullptr;
+	uint32_t m_Capacity = 0;
+	uint32_t m_SlotSize = 0;
+	size_t m_Stride		= 0;
+	RingMode m_Mode		= RingMode::mpsc;
+	HANDLE m_Mapping	= NULL;
+	HANDLE m_Data		= NULL;	 // auto reset, set by producers
+	HANDLE m_Space		= NULL;	 // auto reset, set by the consumer and passed on by a woken producer
+};
+
+// Service side, creates the section
+class RingConsumer : public SharedRing
+{
+public:
+	using handler_t = std::function<void(std::span<const uint8_t> record)>;
+
+	// The mapping and the events are created with `sddl`, the clients it denies can't open the ring
+	bool create(std::wstring_view name,
+				uint32_t capacity,
+				uint32_t slotSize,
+				RingMode mode = RingMode::mpsc,
+				LPCWSTR sddl  = default_sddl);
+
+	// Hand up to `maxBatch` records to the handler, the records are valid only during the call.
+	// Wait up to `timeout` ms when the ring is empty, returns the number of records consumed.
+	// A record claiming more than a slot is skipped
+	size_t consume(const handler_t& handler, size_t maxBatch, DWORD timeout);
+
+	// Release a consumer waiting for data
+	void wake();
+
+	// Consume until the token is stopped
+	void run(const handler_t& handler, std::stop_token token, size_t maxBatch = 256);
+
+private:
+	inline bool has_data()
+	{
+		return slot(m_Tail)->sequence.load(std::memory_order_seq_cst) == m_Tail + 1;
+	}
+
+	uint64_t m_Tail = 0;  // published to the header, never read back from it
+};
+
+// Client side, opens an existing section
+class RingProducer : public SharedRing
+{
+public:
+	bool open(std::wstring_view name);
+
+	// False when the ring is full or the record is larger than the slot
+	bool try_push(std::span<const uint8_t> record);
+
+	// Wait up to `timeout` ms for space
+	bool push(std::span<const uint8_t> record, DWORD timeout = INFINITE);
+};
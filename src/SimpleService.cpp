@@ -4,20 +4,8 @@
 
 const wchar_t* SimpleService::service_name = L"simple_service";
 
-void __stdcall SimpleServiceMain(DWORD argc, LPWSTR* argv)
-{
-	SCMDispatcher::instance()->main<SimpleService>(argc, argv);
-}
-
-void __stdcall SimpleServiceHandler(DWORD control)
-{
-	SCMDispatcher::instance()->handler<SimpleService>(control);
-}
-
 SimpleService::SimpleService()
 {
-	cfg.function_main				  = SimpleServiceMain;
-	cfg.function_handler			  = SimpleServiceHandler;
 	cfg.configuration.lpServiceName	  = service_name;
 	cfg.configuration.dwDesiredAccess = SERVICE_ALL_ACCESS;
 	cfg.configuration.dwServiceType	  = SERVICE_WIN32_SHARE_PROCESS;
@@ -0,0 +1,186 @@
+#include "Snapshot.h"
+
+#include <string.h>
+
+Snapshot::~Snapshot()
+{
+	unmap();
+}
+
+uint64_t Snapshot::checksum(std::span<const uint8_t> data)
+{
+	// 8 bytes per round, the state may be large and it is validated on the start path
+	constexpr uint64_t prime = 0x9E3779B97F4A7C15ull;
+	uint64_t hash			 = data.size() * prime;
+	size_t i				 = 0;
+
+	for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data.data() + i, sizeof(word));
+		hash = (hash ^ (word * prime)) * prime;
+		hash ^= hash >> 29;
+	}
+
+	for (; i < data.size(); i++) {
+		hash = (hash ^ data[i]) * prime;
+	}
+
+	return hash ^ (hash >> 32);
+}
+
+bool Snapshot::map(std::wstring_view path, bool create, uint64_t size)
+{
+	unmap();
+
+	if (create) {
+		m_File = CreateFileW(std::wstring(path).c_str(),
+							 GENERIC_READ | GENERIC_WRITE,
+							 0,
+							 NULL,
+							 CREATE_ALWAYS,
+							 FILE_ATTRIBUTE_NORMAL,
+							 NULL);
+	} else {
+		// Deleted once unmapped, the snapshot is handed to a single instance
+		m_File = CreateFileW(std::wstring(path).c_str(),
+							 GENERIC_READ | DELETE,
+							 FILE_SHARE_READ | FILE_SHARE_DELETE,
+							 NULL,
+							 OPEN_EXISTING,
+							 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE,
+							 NULL);
+	}
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	if (!create) {
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_File, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(Header)) {
+			unmap();
+			return false;
+		}
+		size = fileSize.QuadPart;
+	}
+
+	m_Mapping = CreateFileMappingW(m_File,
+								   NULL,							  // default security attributes
+								   create ? PAGE_READWRITE : PAGE_READONLY,
+								   static_cast<DWORD>(size >> 32),  // size high
+								   static_cast<DWORD>(size),		  // size low
+								   NULL);							  // not named, the file is
+
+	if (!m_Mapping) {
+		// log.error("Cannot map snapshot %ls (%d)\n", path.data(), GetLastError());
+		unmap();
+		return false;
+	}
+
+	m_Header = static_cast<Header*>(MapViewOfFile(m_Mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+	if (!m_Header) {
+		unmap();
+		return false;
+	}
+
+	return true;
+}
+
+void Snapshot::unmap()
+{
+	if (m_Header) {
+		UnmapViewOfFile(m_Header);
+		m_Header = nullptr;
+	}
+
+	if (m_Mapping) {
+		CloseHandle(m_Mapping);
+		m_Mapping = NULL;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+}
+
+SnapshotWriter::SnapshotWriter(std::wstring_view path) : m_Path(path), m_Temporary(m_Path + L".tmp") {}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	unmap();
+	if (!m_Sealed) {
+		DeleteFileW(m_Temporary.c_str());
+	}
+}
+
+std::span<uint8_t> SnapshotWriter::allocate(size_t size)
+{
+	if (m_Header || !map(m_Temporary, true, sizeof(Header) + size)) {
+		return {};
+	}
+
+	m_Header->size = size;
+	return {reinterpret_cast<uint8_t*>(m_Header + 1), size};
+}
+
+bool SnapshotWriter::seal(uint32_t stateVersion)
+{
+	if (!m_Header) {
+		return false;
+	}
+
+	m_Header->version		= version;
+	m_Header->state_version = stateVersion;
+	m_Header->checksum		= checksum({reinterpret_cast<const uint8_t*>(m_Header + 1), m_Header->size});
+	m_Header->magic			= magic;
+
+	m_Sealed = FlushViewOfFile(m_Header, 0) && FlushFileBuffers(m_File);
+	unmap();
+	return m_Sealed;
+}
+
+bool SnapshotWriter::publish()
+{
+	if (!m_Sealed || !MoveFileExW(m_Temporary.c_str(), m_Path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		// log.error("Cannot publish snapshot %ls (%d)\n", m_Path.c_str(), GetLastError());
+		m_Sealed = false;  // removed by the destructor
+		return false;
+	}
+
+	return true;
+}
+
+bool SnapshotReader::open(std::wstring_view path, uint32_t stateVersion)
+{
+	if (!map(path, false, 0)) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(m_File, &fileSize);
+
+	if (m_Header->magic != magic || m_Header->version != version || m_Header->state_version != stateVersion ||
+		m_Header->size > fileSize.QuadPart - sizeof(Header) ||
+		m_Header->checksum != checksum({reinterpret_cast<const uint8_t*>(m_Header + 1), m_Header->size})) {
+		// log.warning("Discard snapshot %ls\n", path.data());
+		unmap();
+		return false;
+	}
+
+	return true;
+}
+
+void SnapshotReader::close()
+{
+	unmap();
+}
+
+std::span<const uint8_t> SnapshotReader::state() const
+{
+	if (!m_Header) {
+		return {};
+	}
+
+	return {reinterpret_cast<const uint8_t*>(m_Header + 1), m_Header->size};
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <span>
+#include <string>
+
+// Warm restart state handed from a stopping service to its next instance.
+// The snapshot is a file mapping, a header with the versions, size and checksum followed by the state.
+// It is written to a temporary file and renamed over the previous one once sealed, the next instance
+// maps it read only and uses the state in place.
+class Snapshot
+{
+public:
+	static constexpr uint32_t magic	  = 0x50414E53;	 // SNAP
+	static constexpr uint32_t version = 1;			 // of the layout, the state version is the service's
+
+	Snapshot() = default;
+	~Snapshot();
+
+	Snapshot(const Snapshot&)			 = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+protected:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t state_version;
+		uint32_t reserved;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	static uint64_t checksum(std::span<const uint8_t> data);
+
+	bool map(std::wstring_view path, bool create, uint64_t size);
+	void unmap();
+
+	HANDLE m_File	 = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = NULL;
+	Header* m_Header = nullptr;
+};
+
+// Stopping side
+class SnapshotWriter : public Snapshot
+{
+public:
+	SnapshotWriter(std::wstring_view path);
+	~SnapshotWriter();
+
+	// Map a state of `size` bytes to fill in place, once per snapshot
+	std::span<uint8_t> allocate(size_t size);
+
+	// Checksum and flush the state, the previous snapshot is still in place
+	bool seal(uint32_t stateVersion);
+
+	// Replace the previous snapshot, it must not be mapped anymore
+	bool publish();
+
+private:
+	std::wstring m_Path;
+	std::wstring m_Temporary;
+	bool m_Sealed = false;
+};
+
+// Starting side, the snapshot is consumed by mapping it,
+// a crash of the loading instance falls back to a cold start instead of reloading a stale state.
+class SnapshotReader : public Snapshot
+{
+public:
+	// False if there is no snapshot, or it was written with another state version or is corrupted
+	bool open(std::wstring_view path, uint32_t stateVersion);
+	void close();
+
+	// Valid until close
+	std::span<const uint8_t> state() const;
+};
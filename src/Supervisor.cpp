@@ -0,0 +1,174 @@
+#include "Supervisor.h"
+
+#include <algorithm>
+
+Supervisor::Supervisor(DWORD pollInterval) : m_PollInterval(pollInterval)
+{
+	m_Monitor = std::jthread([this](std::stop_token token) { monitor(token); });
+}
+
+Supervisor::~Supervisor()
+{
+	m_Monitor.request_stop();
+	if (m_Monitor.joinable()) {
+		m_Monitor.join();
+	}
+}
+
+bool Supervisor::watch(std::wstring_view name)
+{
+	return watch(name, Policy{});
+}
+
+bool Supervisor::watch(std::wstring_view name, Policy policy)
+{
+	Watched svc;
+	svc.policy = policy;
+
+	try {
+		svc.handler = std::make_unique<ServiceHandler>(name);
+	} catch (...) {
+		// log.error("Cannot supervise %ls\n", name.data());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	return m_Services.emplace(name, std::move(svc)).second;
+}
+
+void Supervisor::unwatch(std::wstring_view name)
+{
+	std::unique_lock<std::mutex> lock(m_Mtx);
+	auto it = m_Services.find(name);
+	if (it == m_Services.end()) {
+		return;
+	}
+
+	// Don't wait an in flight restart under the lock
+	auto svc = std::move(it->second);
+	m_Services.erase(it);
+	lock.unlock();
+}
+
+std::vector<Supervisor::Failure> Supervisor::history(std::wstring_view name)
+{
+	std::vector<Failure> failures;
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	auto it = m_Services.find(name);
+	if (it == m_Services.end()) {
+		return failures;
+	}
+
+	auto& svc = it->second;
+	for (uint8_t i = 1; i <= svc.failure_count; i++) {
+		failures.push_back(svc.failures[(svc.next_failure + history_size - i) % history_size]);
+	}
+
+	return failures;
+}
+
+void Supervisor::monitor(std::stop_token token)
+{
+	std::unique_lock<std::mutex> lock(m_Mtx);
+
+	while (!token.stop_requested()) {
+		auto now = GetTickCount64();
+		for (auto& [name, svc] : m_Services) {
+			supervise(svc, now);
+		}
+
+		m_Cv.wait_for(lock, token, std::chrono::milliseconds(m_PollInterval), [] { return false; });
+	}
+}
+
+void Supervisor::supervise(Watched& svc, ULONGLONG now)
+{
+	if (svc.gave_up) {
+		return;
+	}
+
+	// A restart is running on its own thread, a slow service doesn't hold the others
+	if (svc.restart.valid()) {
+		if (svc.restart.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+
+		if (!svc.restart.get()) {
+			record_failure(svc, now, svc.handler->get_status().dwWin32ExitCode);
+		}
+		return;
+	}
+
+	if (svc.restart_at) {
+		if (now >= svc.restart_at) {
+			svc.restart_at = 0;
+			svc.attempt++;
+			svc.restart = std::async(std::launch::async, [handler = svc.handler.get()] { return handler->start(); });
+		}
+		return;
+	}
+
+	auto status = svc.handler->get_status();
+	switch (status.dwCurrentState) {
+		case SERVICE_STOPPED:
+			record_failure(svc, now, status.dwWin32ExitCode);
+			break;
+		case SERVICE_RUNNING:
+			// Running long enough since the last failure, start the backoff over
+			if (svc.attempt && failures_within(svc, now) == 0) {
+				svc.attempt = 0;
+			}
+			break;
+
+		default:  // pending states or the query failed, check again next round
+			break;
+	}
+}
+
+void Supervisor::record_failure(Watched& svc, ULONGLONG now, DWORD exitCode)
+{
+	svc.failures[svc.next_failure] = {now, exitCode};
+	svc.next_failure			   = (svc.next_failure + 1) % history_size;
+	svc.failure_count			   = std::min<uint8_t>(svc.failure_count + 1, history_size);
+
+	if (failures_within(svc, now) > svc.policy.max_restarts) {
+		// log.error("Service is crash looping, stop supervising\n");
+		svc.gave_up = true;
+		return;
+	}
+
+	svc.restart_at = now + backoff(svc);
+}
+
+uint32_t Supervisor::failures_within(const Watched& svc, ULONGLONG now)
+{
+	uint32_t count = 0;
+	for (uint8_t i = 1; i <= svc.failure_count; i++) {
+		auto& failure = svc.failures[(svc.next_failure + history_size - i) % history_size];
+		if (now - failure.tick > svc.policy.window) {
+			break;	// older failures are outside the window too
+		}
+		count++;
+	}
+
+	return count;
+}
+
+DWORD Supervisor::backoff(const Watched& svc)
+{
+	auto& policy   = svc.policy;
+	ULONGLONG wait = policy.backoff_initial;
+	for (uint32_t i = 0; i < svc.attempt && wait < policy.backoff_max; i++) {
+		wait *= 2;
+	}
+	wait = std::min<ULONGLONG>(wait, policy.backoff_max);
+
+	// Spread restarts of services that failed together
+	ULONGLONG jitter = wait * policy.jitter / 100;
+	if (jitter) {
+		wait = wait - jitter + m_Random() % (2 * jitter + 1);
+	}
+
+	return static_cast<DWORD>(wait);
+}
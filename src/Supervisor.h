@@ -0,0 +1,76 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <array>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ServiceHandler.h"
+
+// Watch SCM owned services and restart the ones that stopped,
+// a service that should be stopped on purpose has to be unwatched first.
+class Supervisor
+{
+public:
+	struct Policy {
+		uint32_t max_restarts = 5;		// restarts allowed within the window before giving up
+		DWORD window		  = 60000;	// ms, also the stable running time that resets the backoff
+		DWORD backoff_initial = 1000;	// ms, doubled on each consecutive restart
+		DWORD backoff_max	  = 60000;	// ms
+		uint8_t jitter		  = 20;		// +- percent of the backoff
+	};
+
+	struct Failure {
+		ULONGLONG tick;	 // GetTickCount64 when the stop was observed
+		DWORD exit_code;
+	};
+
+	Supervisor(DWORD pollInterval = 1000);
+	~Supervisor();
+
+	bool watch(std::wstring_view name);
+	bool watch(std::wstring_view name, Policy policy);
+	void unwatch(std::wstring_view name);
+
+	// Most recent failures first
+	std::vector<Failure> history(std::wstring_view name);
+
+private:
+	static constexpr size_t history_size = 16;
+
+	struct Watched {
+		Policy policy;
+		std::unique_ptr<ServiceHandler> handler;
+
+		std::array<Failure, history_size> failures{};
+		uint8_t next_failure  = 0;
+		uint8_t failure_count = 0;
+
+		uint32_t attempt	 = 0;  // consecutive restarts, drives the backoff
+		ULONGLONG restart_at = 0;  // 0 when no restart is scheduled
+		bool gave_up		 = false;
+		std::future<bool> restart;	// in flight restart, never waited by the monitor
+	};
+
+	void monitor(std::stop_token token);
+	void supervise(Watched& svc, ULONGLONG now);
+	void record_failure(Watched& svc, ULONGLONG now, DWORD exitCode);
+	uint32_t failures_within(const Watched& svc, ULONGLONG now);
+	DWORD backoff(const Watched& svc);
+
+	const DWORD m_PollInterval;
+	std::mutex m_Mtx;
+	std::condition_variable_any m_Cv;
+	std::map<std::wstring, Watched, std::less<>> m_Services;
+	std::minstd_rand m_Random{std::random_device{}()};
+	std::jthread m_Monitor;	 // last, started after everything else is constructed
+};
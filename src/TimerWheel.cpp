@@ -0,0 +1,264 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <utility>
+
+TimerWheel::TimerWheel(DWORD resolution) : m_Resolution(resolution ? resolution : 1)
+{
+	for (auto& level : m_Wheel) {
+		level.fill(none);
+	}
+}
+
+TimerWheel::TimerId TimerWheel::schedule(DWORD delay, callback_t callback)
+{
+	return add(delay, 0, 0, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::schedule_periodic(DWORD period, callback_t callback, DWORD jitter)
+{
+	return add(period, period, jitter, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::add(DWORD delay, DWORD period, DWORD jitter, callback_t callback)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+
+	uint32_t index;
+	if (m_Free.empty()) {
+		index = static_cast<uint32_t>(m_Timers.size());
+		m_Timers.emplace_back();
+	} else {
+		index = m_Free.back();
+		m_Free.pop_back();
+	}
+
+	auto& timer		= m_Timers[index];
+	timer.state		= State::armed;
+	timer.cancelled = false;
+	timer.period	= period ? static_cast<uint32_t>(ticks(period, 0)) : 0;
+	timer.jitter	= jitter / m_Resolution;
+	timer.expires	= m_Current + ticks(delay, jitter);
+	timer.callback	= std::move(callback);
+	link(index);
+
+	m_Cv.notify_all();
+	return {index, timer.generation};
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	if (id.index >= m_Timers.size() || m_Timers[id.index].generation != id.generation) {
+		return false;
+	}
+
+	auto& timer = m_Timers[id.index];
+	switch (timer.state) {
+		case State::armed:
+			unlink(id.index);
+			release(id.index);
+			return true;
+		case State::firing:
+			// The wheel releases it after the callback returns
+			return !std::exchange(timer.cancelled, true);
+
+		default:
+			break;
+	}
+
+	return false;
+}
+
+void TimerWheel::suspend()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Suspended = true;
+}
+
+void TimerWheel::resume()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Suspended = false;
+	m_Cv.notify_all();
+}
+
+void TimerWheel::clear()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	for (uint32_t index = 0; index < m_Timers.size(); index++) {
+		auto& timer = m_Timers[index];
+		switch (timer.state) {
+			case State::armed:
+				unlink(index);
+				release(index);
+				break;
+			case State::firing:
+				// The wheel releases it after the callback returns
+				timer.cancelled = true;
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+size_t TimerWheel::size()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	return m_Armed;
+}
+
+void TimerWheel::run(std::stop_token token)
+{
+	std::vector<std::pair<uint32_t, Timer*>> expired;
+	std::unique_lock<std::mutex> lock(m_Mtx);
+	bool rebase = true;
+
+	while (!token.stop_requested()) {
+		if (m_Suspended || !m_Armed) {
+			m_Cv.wait(lock, token, [this] { return !m_Suspended && m_Armed; });
+			rebase = true;
+			continue;
+		}
+
+		// Don't catch up the ticks we were suspended or had nothing to run
+		if (rebase) {
+			m_Base = GetTickCount64() - m_Current * m_Resolution;
+			rebase = false;
+		}
+
+		auto target = (GetTickCount64() - m_Base) / m_Resolution;
+		while (m_Current < target && !m_Suspended) {
+			tick(expired);
+			if (expired.empty()) {
+				continue;
+			}
+
+			// Run the callbacks unlocked, they may schedule or cancel timers
+			lock.unlock();
+			for (auto& [index, timer] : expired) {
+				timer->callback();
+			}
+			lock.lock();
+
+			for (auto& [index, timer] : expired) {
+				if (timer->period && !timer->cancelled) {
+					timer->state   = State::armed;
+					timer->expires = m_Current + ticks(timer->period * m_Resolution, timer->jitter * m_Resolution);
+					link(index);
+				} else {
+					release(index);
+				}
+			}
+			expired.clear();
+		}
+
+		m_Cv.wait_for(lock, token, std::chrono::milliseconds(m_Resolution), [] { return false; });
+	}
+}
+
+void TimerWheel::tick(std::vector<std::pair<uint32_t, Timer*>>& expired)
+{
+	m_Current++;
+
+	// Cascade the coarser levels that turned, their timers move to a finer level
+	for (uint32_t level = 1; level < levels; level++) {
+		if (m_Current & ((1ull << (slot_bits * level)) - 1)) {
+			break;
+		}
+
+		// A timer expiring on this very tick fires now, linked it would be clamped to the next one
+		auto index = std::exchange(m_Wheel[level][(m_Current >> (slot_bits * level)) & (slots - 1)], none);
+		while (index != none) {
+			auto& timer = m_Timers[index];
+			auto next	= timer.next;
+			m_Armed--;
+			if (timer.expires <= m_Current) {
+				timer.state = State::firing;
+				expired.emplace_back(index, &timer);
+			} else {
+				link(index);
+			}
+			index = next;
+		}
+	}
+
+	auto index = std::exchange(m_Wheel[0][m_Current & (slots - 1)], none);
+	while (index != none) {
+		auto& timer = m_Timers[index];
+		auto next	= timer.next;
+		timer.state = State::firing;
+		m_Armed--;
+		expired.emplace_back(index, &timer);
+		index = next;
+	}
+}
+
+void TimerWheel::link(uint32_t index)
+{
+	auto& timer	  = m_Timers[index];
+	auto expires  = std::max(timer.expires, m_Current + 1);
+	uint64_t diff = expires - m_Current;
+
+	uint32_t level = 0;
+	while (level < levels - 1 && diff >= (1ull << (slot_bits * (level + 1)))) {
+		level++;
+	}
+
+	// Beyond the wheel range, park it at the far end of the top level, it cascades back there
+	if (diff >= max_ticks) {
+		expires = m_Current + max_ticks - 1;
+	}
+
+	uint32_t slot = (expires >> (slot_bits * level)) & (slots - 1);
+	auto& head	  = m_Wheel[level][slot];
+
+	timer.bucket = static_cast<uint16_t>(level * slots + slot);
+	timer.prev	 = none;
+	timer.next	 = head;
+	if (head != none) {
+		m_Timers[head].prev = index;
+	}
+	head = index;
+	m_Armed++;
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+	auto& timer = m_Timers[index];
+
+	if (timer.prev != none) {
+		m_Timers[timer.prev].next = timer.next;
+	} else {
+		m_Wheel[timer.bucket / slots][timer.bucket % slots] = timer.next;
+	}
+
+	if (timer.next != none) {
+		m_Timers[timer.next].prev = timer.prev;
+	}
+
+	timer.prev = timer.next = none;
+	m_Armed--;
+}
+
+void TimerWheel::release(uint32_t index)
+{
+	auto& timer = m_Timers[index];
+	timer.state = State::free;
+	timer.generation++;	 // invalidate the ids handed for this timer
+	timer.callback = nullptr;
+	m_Free.push_back(index);
+}
+
+uint64_t TimerWheel::ticks(DWORD period, DWORD jitter)
+{
+	int64_t ticks  = (period + m_Resolution - 1) / m_Resolution;
+	int64_t spread = jitter / m_Resolution;
+	if (spread) {
+		ticks += static_cast<int64_t>(m_Random() % (2 * spread + 1)) - spread;
+	}
+
+	return std::max<int64_t>(ticks, 1);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stop_token>
+#include <vector>
+
+// Hierarchical timing wheel for the periodic jobs of a service.
+// Schedule and cancel are O(1), the timers are linked into the slot of their expiration
+// and cascade to a finer level when the coarser level turns.
+// Callbacks run on the thread that runs the wheel, a callback may schedule or cancel timers.
+class TimerWheel
+{
+public:
+	using callback_t = std::function<void()>;
+
+	struct TimerId {
+		uint32_t index		= UINT32_MAX;
+		uint32_t generation = 0;
+	};
+
+	TimerWheel(DWORD resolution = 10);	// ms per tick
+
+	TimerId schedule(DWORD delay, callback_t callback);
+
+	// Re-armed after each run with a random +-jitter ms, spreads timers that started together
+	TimerId schedule_periodic(DWORD period, callback_t callback, DWORD jitter = 0);
+
+	// False if the timer already fired (one shot) or was cancelled
+	bool cancel(TimerId id);
+
+	// While suspended the wheel doesn't turn, on resume the timers continue where they stopped
+	void suspend();
+	void resume();
+
+	// Drop every timer, a callback running now is not re-armed. The ids handed so far become invalid
+	void clear();
+
+	size_t size();
+
+	// Turn the wheel until the token is stopped
+	void run(std::stop_token token);
+
+private:
+	static constexpr uint32_t levels	 = 4;
+	static constexpr uint32_t slot_bits	 = 6;
+	static constexpr uint32_t slots		 = 1 << slot_bits;
+	static constexpr uint64_t max_ticks	 = 1ull << (slot_bits * levels);
+
+	static constexpr uint32_t none = UINT32_MAX;
+
+	enum class State : uint8_t { free, armed, firing };
+
+	struct Timer {
+		uint32_t prev		= none;
+		uint32_t next		= none;
+		uint32_t generation = 0;
+		uint16_t bucket		= 0;  // level * slots + slot
+		State state			= State::free;
+		bool cancelled		= false;  // cancelled while its callback runs
+		uint64_t expires	= 0;	  // tick
+		uint32_t period		= 0;  // ticks, 0 for one shot
+		uint32_t jitter		= 0;  // ticks
+		callback_t callback;
+	};
+
+	TimerId add(DWORD delay, DWORD period, DWORD jitter, callback_t callback);
+	void link(uint32_t index);
+	void unlink(uint32_t index);
+	void release(uint32_t index);
+	void tick(std::vector<std::pair<uint32_t, Timer*>>& expired);
+	uint64_t ticks(DWORD period, DWORD jitter);
+
+	const DWORD m_Resolution;
+
+	std::mutex m_Mtx;
+	std::condition_variable_any m_Cv;
+	std::deque<Timer> m_Timers;	 // stable storage, indexed by TimerId
+	std::vector<uint32_t> m_Free;
+	std::array<std::array<uint32_t, slots>, levels> m_Wheel;  // list heads
+	size_t m_Armed = 0;
+
+	uint64_t m_Current = 0;	 // current tick
+	ULONGLONG m_Base   = 0;	 // GetTickCount64 of tick 0, moved forward over idle and suspended periods
+	bool m_Suspended   = false;
+	std::minstd_rand m_Random{std::random_device{}()};
+};
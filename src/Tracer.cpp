@@ -0,0 +1,203 @@
+#include "Tracer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+
+namespace
+{
+// Marks the buffer of an exiting thread, the flusher frees it once drained
+struct BufferHolder {
+	std::atomic<bool>* retired = nullptr;
+
+	~BufferHolder()
+	{
+		if (retired) {
+			retired->store(true, std::memory_order_release);
+		}
+	}
+};
+}  // namespace
+
+int64_t Tracer::now()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+bool Tracer::start(std::wstring_view path, DWORD interval)
+{
+	stop();
+
+	{
+		std::lock_guard<std::mutex> g(s_Mtx);
+		s_File = CreateFileW(std::wstring(path).c_str(),
+							 GENERIC_WRITE,
+							 FILE_SHARE_READ,
+							 NULL,
+							 CREATE_ALWAYS,
+							 FILE_ATTRIBUTE_NORMAL,
+							 NULL);
+
+		if (s_File == INVALID_HANDLE_VALUE) {
+			// log.error("Cannot create trace %ls (%d)\n", path.data(), GetLastError());
+			return false;
+		}
+
+		// The JSON array format, the viewers accept it without the closing bracket
+		s_Json = "[\n";
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		s_Frequency = frequency.QuadPart;
+		s_Start		= now();
+	}
+
+	s_Enabled.store(true, std::memory_order_relaxed);
+	s_Flusher = std::jthread([interval](std::stop_token token) { run(token, interval); });
+	return true;
+}
+
+void Tracer::stop()
+{
+	s_Enabled.store(false, std::memory_order_relaxed);
+
+	if (s_Flusher.joinable()) {
+		s_Flusher.request_stop();
+		s_Flusher.join();
+	}
+
+	std::lock_guard<std::mutex> g(s_Mtx);
+	if (s_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(s_File);
+		s_File = INVALID_HANDLE_VALUE;
+	}
+}
+
+void Tracer::record(const TraceName& name, char phase, int64_t time, int64_t value)
+{
+	auto buf   = buffer();
+	auto chunk = buf->tail;
+	auto count = chunk->count.load(std::memory_order_relaxed);
+
+	if (count == Chunk::capacity) {
+		auto next = new Chunk;
+		chunk->next.store(next, std::memory_order_release);
+		buf->tail = chunk = next;
+		count			  = 0;
+	}
+
+	chunk->events[count] = {&name, time, value, phase};
+	chunk->count.store(count + 1, std::memory_order_release);
+}
+
+Tracer::Buffer* Tracer::buffer()
+{
+	thread_local Buffer* local = nullptr;
+	thread_local BufferHolder holder;
+
+	if (!local) {
+		auto chunk = new Chunk;
+		local		   = new Buffer{GetCurrentThreadId(), chunk, chunk, 0};
+		holder.retired = &local->retired;
+
+		std::lock_guard<std::mutex> g(s_Mtx);
+		s_Buffers.push_back(local);
+	}
+
+	return local;
+}
+
+void Tracer::flush()
+{
+	std::lock_guard<std::mutex> g(s_Mtx);
+	auto pid = GetCurrentProcessId();
+	char line[256];
+
+	for (auto it = s_Buffers.begin(); it != s_Buffers.end();) {
+		auto buf	 = *it;
+		bool retired = buf->retired.load(std::memory_order_acquire);
+
+		while (true) {
+			auto chunk = buf->head;
+			auto count = chunk->count.load(std::memory_order_acquire);
+
+			for (; buf->consumed < count; buf->consumed++) {
+				auto& event = chunk->events[buf->consumed];
+				auto ts		= static_cast<double>(event.time - s_Start) * 1e6 / s_Frequency;
+
+				int length;
+				if (event.phase == 'X') {
+					auto dur = static_cast<double>(event.value) * 1e6 / s_Frequency;
+					length	 = snprintf(line,
+										sizeof(line),
+										"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+										"\"pid\":%lu,\"tid\":%lu},\n",
+										event.name->name,
+										event.name->category,
+										ts,
+										dur,
+										pid,
+										buf->thread_id);
+				} else {
+					length = snprintf(line,
+									  sizeof(line),
+									  "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+									  "\"pid\":%lu,\"tid\":%lu,\"args\":{\"value\":%lld}},\n",
+									  event.name->name,
+									  event.name->category,
+									  ts,
+									  pid,
+									  buf->thread_id,
+									  static_cast<long long>(event.value));
+				}
+
+				if (length > 0) {
+					s_Json.append(line, std::min<size_t>(length, sizeof(line) - 1));
+				}
+			}
+
+			// The producer moved on from a full chunk, it won't touch it again
+			auto next = count == Chunk::capacity ? chunk->next.load(std::memory_order_acquire) : nullptr;
+			if (!next) {
+				break;
+			}
+
+			delete chunk;
+			buf->head	  = next;
+			buf->consumed = 0;
+		}
+
+		if (retired) {
+			delete buf->head;
+			delete buf;
+			it = s_Buffers.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	if (s_File != INVALID_HANDLE_VALUE && !s_Json.empty()) {
+		DWORD written = 0;
+		if (!WriteFile(s_File, s_Json.data(), static_cast<DWORD>(s_Json.size()), &written, NULL)) {
+			// log.warning("Trace write failed (%d)\n", GetLastError());
+		}
+	}
+	s_Json.clear();
+}
+
+void Tracer::run(std::stop_token token, DWORD interval)
+{
+	std::mutex mtx;
+	std::condition_variable_any cv;
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (!cv.wait_for(lock, token, std::chrono::milliseconds(interval), [] { return false; }) &&
+		   !token.stop_requested()) {
+		flush();
+	}
+
+	flush();  // the events recorded until stop
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Name of a traced event, define as a constexpr so events carry only its address.
+// The strings are written to the trace as is, they must not need JSON escaping.
+struct TraceName {
+	const char* category;
+	const char* name;
+};
+
+// Process wide timeline of the framework events in the Chrome trace format (chrome://tracing, Perfetto UI).
+// Each thread records into its own buffer, a flusher thread drains the buffers to the file.
+// Disabled by default, a disabled event costs a relaxed load.
+class Tracer
+{
+public:
+	static bool enabled()
+	{
+		return s_Enabled.load(std::memory_order_relaxed);
+	}
+
+	// Record and append the events to `path` every `interval` ms
+	static bool start(std::wstring_view path, DWORD interval = 1000);
+	static void stop();
+
+	static void instant(const TraceName& name, uint64_t value = 0)
+	{
+		if (enabled()) {
+			record(name, 'i', now(), value);
+		}
+	}
+
+	// A complete event from construction to destruction
+	class Scope
+	{
+	public:
+		Scope(const TraceName& name) : m_Name(enabled() ? &name : nullptr), m_Begin(m_Name ? now() : 0) {}
+
+		~Scope()
+		{
+			if (m_Name) {
+				record(*m_Name, 'X', m_Begin, now() - m_Begin);
+			}
+		}
+
+		Scope(const Scope&)			   = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const TraceName* m_Name;
+		int64_t m_Begin;
+	};
+
+	template <class F>
+	static auto call(const TraceName& name, F&& f)
+	{
+		Scope scope(name);
+		return f();
+	}
+
+private:
+	struct Event {
+		const TraceName* name;
+		int64_t time;	// QPC ticks
+		int64_t value;	// duration of a complete event, argument of an instant event
+		char phase;
+	};
+
+	// Written by its thread only, read by the flusher up to the published count
+	struct Chunk {
+		static constexpr uint32_t capacity = 1024;
+
+		Event events[capacity];
+		std::atomic<uint32_t> count{0};
+		std::atomic<Chunk*> next{nullptr};
+	};
+
+	struct Buffer {
+		DWORD thread_id;
+		Chunk* tail;					   // producer
+		Chunk* head;					   // flusher
+		uint32_t consumed;				   // flusher, of the head chunk
+		std::atomic<bool> retired{false};  // the thread exited
+	};
+
+	static int64_t now();
+	static void record(const TraceName& name, char phase, int64_t time, int64_t value);
+	static Buffer* buffer();
+	static void flush();
+	static void run(std::stop_token token, DWORD interval);
+
+	static inline std::atomic<bool> s_Enabled{false};
+	static inline std::mutex s_Mtx;	 // the buffers list and the file
+	static inline std::vector<Buffer*> s_Buffers;
+	static inline HANDLE s_File		  = INVALID_HANDLE_VALUE;
+	static inline int64_t s_Frequency = 1;
+	static inline int64_t s_Start	  = 0;
+	static inline std::string s_Json;
+	static inline std::jthread s_Flusher;
+};
@@ -0,0 +1,191 @@
+#include "WaitHint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace
+{
+constexpr const wchar_t* value_name = L"WaitHint";
+
+std::wstring parameters_key(LPCWSTR serviceName)
+{
+	return L"SYSTEM\\CurrentControlSet\\Services\\" + std::wstring(serviceName) + L"\\Parameters";
+}
+}  // namespace
+
+void WaitHint::Quantile::add(double duration)
+{
+	if (count < 5) {
+		// Insertion sort of the first durations
+		uint32_t i = count++;
+		for (; i && heights[i - 1] > duration; i--) {
+			heights[i] = heights[i - 1];
+		}
+		heights[i] = duration;
+
+		if (count == 5) {
+			for (int32_t m = 0; m < 5; m++) {
+				positions[m] = m + 1;
+				desired[m]	 = 1 + 4 * increments[m];
+			}
+		}
+		return;
+	}
+
+	count++;
+
+	// Cell of the duration, the extreme markers follow the min and the max
+	int32_t cell = 0;
+	if (duration < heights[0]) {
+		heights[0] = duration;
+	} else if (duration >= heights[4]) {
+		heights[4] = duration;
+		cell	   = 3;
+	} else {
+		while (duration >= heights[cell + 1]) {
+			cell++;
+		}
+	}
+
+	for (int32_t m = cell + 1; m < 5; m++) {
+		positions[m]++;
+	}
+	for (int32_t m = 0; m < 5; m++) {
+		desired[m] += increments[m];
+	}
+
+	// Move the middle markers toward their desired position, a marker at a time
+	for (int32_t m = 1; m < 4; m++) {
+		double off = desired[m] - positions[m];
+		if ((off >= 1 && positions[m + 1] - positions[m] > 1) ||
+			(off <= -1 && positions[m - 1] - positions[m] < -1)) {
+			int32_t d = off > 0 ? 1 : -1;
+
+			// Piecewise parabolic prediction, linear when it leaves the neighbours order
+			double height =
+				heights[m] +
+				double(d) / (positions[m + 1] - positions[m - 1]) *
+					((positions[m] - positions[m - 1] + d) * (heights[m + 1] - heights[m]) /
+						 (positions[m + 1] - positions[m]) +
+					 (positions[m + 1] - positions[m] - d) * (heights[m] - heights[m - 1]) /
+						 (positions[m] - positions[m - 1]));
+
+			if (height <= heights[m - 1] || height >= heights[m + 1]) {
+				height = heights[m] + d * (heights[m + d] - heights[m]) / (positions[m + d] - positions[m]);
+			}
+
+			heights[m] = height;
+			positions[m] += d;
+		}
+	}
+}
+
+double WaitHint::Quantile::estimate() const
+{
+	if (count < 5) {
+		// Too few for the markers, the nearest rank of the sorted durations
+		auto rank = static_cast<uint32_t>(std::ceil(percentile * count));
+		return heights[std::max<uint32_t>(rank, 1) - 1];
+	}
+
+	return heights[2];
+}
+
+bool WaitHint::Quantile::valid() const
+{
+	auto filled = std::min<uint32_t>(count, 5);
+	for (uint32_t m = 0; m < filled; m++) {
+		if (!std::isfinite(heights[m]) || heights[m] < 0 || (m && heights[m] < heights[m - 1])) {
+			return false;
+		}
+	}
+
+	if (count < 5) {
+		return true;
+	}
+
+	// The markers sit at increasing ranks from the first to the last duration
+	if (count > INT32_MAX || positions[0] != 1 || positions[4] != static_cast<int32_t>(count)) {
+		return false;
+	}
+	for (uint32_t m = 0; m < 5; m++) {
+		if (!std::isfinite(desired[m]) || (m && positions[m] <= positions[m - 1])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool WaitHint::load(LPCWSTR serviceName)
+{
+	State state{};
+	DWORD size = sizeof(state);
+	auto key   = parameters_key(serviceName);
+
+	if (RegGetValueW(HKEY_LOCAL_MACHINE, key.c_str(), value_name, RRF_RT_REG_BINARY, NULL, &state, &size) !=
+		ERROR_SUCCESS) {
+		return false;
+	}
+
+	// Discard a state of another layout or a corrupt one
+	if (size != sizeof(state) || state.version != version) {
+		return false;
+	}
+	for (auto& quantile : state.transitions) {
+		if (!quantile.valid()) {
+			// log.warning("Corrupt wait hints of %ls, discarded\n", serviceName);
+			return false;
+		}
+	}
+
+	m_State = state;
+	return true;
+}
+
+bool WaitHint::save(LPCWSTR serviceName)
+{
+	HKEY key	   = NULL;
+	auto subKey	   = parameters_key(serviceName);
+	LSTATUS status = RegCreateKeyExW(HKEY_LOCAL_MACHINE,
+									 subKey.c_str(),
+									 0,
+									 NULL,
+									 REG_OPTION_NON_VOLATILE,
+									 KEY_WRITE,
+									 NULL,
+									 &key,
+									 NULL);
+	if (status != ERROR_SUCCESS) {
+		// log.warning("RegCreateKeyExW failed (%d)\n", status);  // ERROR_ACCESS_DENIED without admin rights
+		return false;
+	}
+
+	auto data = reinterpret_cast<const BYTE*>(&m_State);
+	status	  = RegSetValueExW(key, value_name, 0, REG_BINARY, data, sizeof(m_State));
+	RegCloseKey(key);
+
+	if (status != ERROR_SUCCESS) {
+		// log.warning("RegSetValueExW failed (%d)\n", status);
+		return false;
+	}
+	return true;
+}
+
+void WaitHint::observe(Transition transition, DWORD duration)
+{
+	m_State.transitions[static_cast<size_t>(transition)].add(duration);
+}
+
+DWORD WaitHint::hint(Transition transition) const
+{
+	auto& quantile = m_State.transitions[static_cast<size_t>(transition)];
+	if (!quantile.count) {
+		return default_hint;
+	}
+
+	// Clamp before the conversion, a double out of the DWORD range doesn't convert
+	auto hint = std::clamp(quantile.estimate() * margin, double(min_hint), double(max_hint));
+	return std::isfinite(hint) ? static_cast<DWORD>(hint) : default_hint;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <array>
+
+// Wait hints of the pending states, learned from how long the past transitions of the service took.
+// Each transition keeps a P-square estimate of the 95th percentile of its durations (constant space,
+// no samples kept), the hint is the estimate with a margin. The estimates are persisted in
+// HKLM\SYSTEM\CurrentControlSet\Services\<name>\Parameters so a new process starts with them.
+// Not synchronized, the transitions of a service are serialized by its state machine.
+class WaitHint
+{
+public:
+	enum class Transition : uint8_t {
+		start = 0,
+		stop,
+		pause,
+		resume,
+		COUNT
+	};
+
+	static constexpr DWORD default_hint = 3000;	 // ms, until the transition was seen
+	// ms, the p95 x 1.5 margin covers the slow runs above it. The drain and quiesce loops report a
+	// checkpoint twice per floor, a poller never reads a slow but progressing transition as hung
+	static constexpr DWORD min_hint = 1000;
+	static constexpr DWORD max_hint = 10 * 60 * 1000;  // ms
+
+	// Load the estimates of the previous runs, false if there are none or they are corrupt
+	bool load(LPCWSTR serviceName);
+
+	// Writing HKLM needs an administrative account, a service account without it keeps the
+	// estimates for the process only
+	bool save(LPCWSTR serviceName);
+
+	void observe(Transition transition, DWORD duration);
+
+	// ms to report with the pending state of the transition
+	DWORD hint(Transition transition) const;
+
+private:
+	static constexpr uint32_t version = 1;
+
+	// P-square markers, min, p/2, p, (1+p)/2 and max of the durations.
+	// The first 5 durations fill the heights, sorted
+	struct Quantile {
+		uint32_t count = 0;
+		int32_t positions[5];
+		double heights[5];
+		double desired[5];
+
+		void add(double duration);
+		double estimate() const;
+
+		// Finite sorted heights and consistent markers, a loaded state is checked before use
+		bool valid() const;
+	};
+
+	struct State {
+		uint32_t version;
+		std::array<Quantile, static_cast<size_t>(Transition::COUNT)> transitions;
+	};
+
+	static constexpr double percentile = 0.95;
+	static constexpr double margin	   = 1.5;
+
+	// Desired marker moves per duration
+	static constexpr double increments[5] = {0, percentile / 2, percentile, (1 + percentile) / 2, 1};
+
+	State m_State{version};
+};
@@ -0,0 +1,79 @@
+#include "Watchdog.h"
+
+#include <algorithm>
+#include <utility>
+
+std::shared_ptr<Watchdog::Heartbeat> Watchdog::enroll(std::wstring name, DWORD deadline, Escalation escalation)
+{
+	auto heartbeat			  = std::make_shared<Heartbeat>(std::move(name), deadline, escalation);
+	heartbeat->m_LastProgress = GetTickCount64();
+
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Heartbeats.push_back(heartbeat);
+	return heartbeat;
+}
+
+void Watchdog::scan(const escalate_t& escalate)
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	if (m_Suspended) {
+		return;
+	}
+	auto now = GetTickCount64();
+
+	// Drop heartbeats their owner released
+	std::erase_if(m_Heartbeats, [](const auto& heartbeat) { return heartbeat.use_count() == 1; });
+
+	for (auto& heartbeat : m_Heartbeats) {
+		auto beats = heartbeat->m_Beats.load(std::memory_order_relaxed);
+		if (beats != heartbeat->m_LastSeen) {
+			heartbeat->m_LastSeen	  = beats;
+			heartbeat->m_LastProgress = now;
+			heartbeat->m_Escalated	  = false;
+			continue;
+		}
+
+		// Escalate once per stall, a late beat re-arms the heartbeat
+		if (!heartbeat->m_Escalated && now - heartbeat->m_LastProgress > heartbeat->m_Deadline) {
+			heartbeat->m_Escalated = true;
+			escalate(*heartbeat);
+		}
+	}
+}
+
+void Watchdog::suspend()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	m_Suspended = true;
+}
+
+void Watchdog::resume()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+	if (!std::exchange(m_Suspended, false)) {
+		return;
+	}
+
+	auto now = GetTickCount64();
+	for (auto& heartbeat : m_Heartbeats) {
+		heartbeat->m_LastSeen	  = heartbeat->m_Beats.load(std::memory_order_relaxed);
+		heartbeat->m_LastProgress = now;
+		heartbeat->m_Escalated	  = false;
+	}
+}
+
+DWORD Watchdog::next_wait()
+{
+	std::lock_guard<std::mutex> g(m_Mtx);
+
+	DWORD deadline = default_deadline;
+	for (auto& heartbeat : m_Heartbeats) {
+		deadline = std::min(deadline, heartbeat->m_Deadline);
+	}
+
+	// Scan twice per the shortest deadline, jitter by +-25% so services in
+	// a shared process don't wake together
+	DWORD interval = std::max<DWORD>(deadline / 2, 100);
+	DWORD jitter   = interval / 4;
+	return interval - jitter + m_Random() % (2 * jitter + 1);
+}
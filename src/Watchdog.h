@@ -0,0 +1,93 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// Heartbeat monitor for service owned threads.
+// Threads enroll once and call beat() from their loop, the service idle thread
+// scans the heartbeats on a jittered timer and escalates the ones that missed their deadline.
+class Watchdog
+{
+public:
+	enum class Escalation : uint8_t {
+		log = 0,  // write a debug log entry
+		status,	  // report the failure to the SCM through the service status
+		stop	  // stop the service so the SCM recovery actions can restart it
+	};
+
+	class alignas(64) Heartbeat	 // own cache line, beat() must not false share with other workers
+	{
+	public:
+		Heartbeat(std::wstring name, DWORD deadline, Escalation escalation)
+			: m_Name(std::move(name)), m_Deadline(deadline), m_Escalation(escalation)
+		{
+		}
+
+		// Called by the owner thread only, a single relaxed store
+		inline void beat()
+		{
+			m_Beats.store(++m_Sequence, std::memory_order_relaxed);
+		}
+
+		const std::wstring& name() const
+		{
+			return m_Name;
+		}
+
+		DWORD deadline() const
+		{
+			return m_Deadline;
+		}
+
+		Escalation escalation() const
+		{
+			return m_Escalation;
+		}
+
+	private:
+		std::atomic<uint64_t> m_Beats{0};
+		uint64_t m_Sequence = 0;  // owner thread private
+
+		// monitor thread private
+		uint64_t m_LastSeen		 = 0;
+		ULONGLONG m_LastProgress = 0;
+		bool m_Escalated		 = false;
+
+		const std::wstring m_Name;
+		const DWORD m_Deadline;
+		const Escalation m_Escalation;
+
+		friend class Watchdog;
+	};
+
+	using escalate_t = std::function<void(const Heartbeat&)>;
+
+	// The heartbeat is monitored as long as the caller holds the returned pointer
+	std::shared_ptr<Heartbeat> enroll(std::wstring name, DWORD deadline, Escalation escalation = Escalation::log);
+
+	// Check all heartbeats, call `escalate` once for each heartbeat that missed its deadline
+	void scan(const escalate_t& escalate);
+
+	// Time to wait before the next scan
+	DWORD next_wait();
+
+	// While suspended scan escalates nothing, e.g. the owners are parked by a pause.
+	// Resume restarts the deadline of every heartbeat
+	void suspend();
+	void resume();
+
+private:
+	static constexpr DWORD default_deadline = 2000;	 // scan period while nothing is enrolled
+
+	std::mutex m_Mtx;  // guards enroll against scan, never taken by beat()
+	std::vector<std::shared_ptr<Heartbeat>> m_Heartbeats;
+	bool m_Suspended = false;
+	std::minstd_rand m_Random{std::random_device{}()};
+};
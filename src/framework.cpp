@@ -1,7 +1,15 @@
 #include "framework.h"
 
+#include <filesystem>
 #include <memory>
 #include <mutex>
+#include <vector>
+
+#include "Tracer.h"
+
+std::filesystem::path GetServicePath();	 // Service.cpp
+
+static constexpr TraceName trace_dispatch{"framework", "dispatch"};
 
 static std::mutex _mtx;	 // limit scope
 std::shared_ptr<SCMDispatcher> SCMDispatcher::m_Instance = nullptr;
@@ -23,46 +31,59 @@ SC_HANDLE SCMDispatcher::scm_handle()
 
 void SCMDispatcher::run_all()
 {
-	for (auto& svc : m_ServicesMap) {
+	for (auto& svc : m_Registry.snapshot()) {
 		svc.second->Service::run();
 	}
 }
 
 void SCMDispatcher::stop_all()
 {
-	for (auto& svc : m_ServicesMap) {
+	for (auto& svc : m_Registry.snapshot()) {
 		svc.second->Service::stop();
 	}
 }
 
 void SCMDispatcher::install_all()
 {
-	for (auto& svc : m_ServicesMap) {
+	for (auto& svc : m_Registry.snapshot()) {
 		svc.second->install();
 	}
+
+	if (m_LightHost.size()) {
+		auto path = GetServicePath();
+		m_LightHost.install_all(m_SCM, path.c_str());
+	}
 }
 
 void SCMDispatcher::uninstall_all()
 {
-	for (auto& svc : m_ServicesMap) {
+	for (auto& svc : m_Registry.snapshot()) {
 		svc.second->uninstall();
 	}
+
+	m_LightHost.uninstall_all(m_SCM);
 }
 
 void SCMDispatcher::dispatch()
 {
-	if (m_ServicesMap.size() == 0) {
+	Tracer::Scope scope(trace_dispatch);
+
+	// The table is fixed for the process, services added later can't be started by the SCM
+	auto services = m_Registry.snapshot();
+	if (services.size() == 0 && m_LightHost.size() == 0) {
 		return;	 // No service was registered
 	}
 
-	auto table = std::make_unique<SERVICE_TABLE_ENTRYW[]>(m_ServicesMap.size() + 1);
+	std::vector<SERVICE_TABLE_ENTRYW> table;
+	table.reserve(services.size() + m_LightHost.size() + 1);
 
-	int i	   = 0;
-	for (auto& svc : m_ServicesMap) {
-		table[i++] = {const_cast<LPWSTR>(svc.first.data()), svc.second->cfg.function_main};
+	for (auto& svc : services) {
+		table.push_back({const_cast<LPWSTR>(svc.first.data()), svc.second->cfg.function_main});
 	}
+	m_LightHost.table(table);
+	table.push_back({NULL, NULL});
 
-	if (!StartServiceCtrlDispatcherW(table.get())) {
+	if (!StartServiceCtrlDispatcherW(table.data())) {
 		// log.fatal("Service is forcely closed");
 	}
 }
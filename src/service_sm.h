@@ -1,6 +1,6 @@
 #pragma once
 
-#include <cpp-utils/StateMachine.h>
+#include "statemachine.h"
 
 enum class ServiceStates : uint8_t {
 	uninstalled = 0,
@@ -18,8 +18,14 @@ public:
 
 	ServiceStateMachine() : base_t(&TransitionTable[0][0], state_t::uninstalled) {}
 
+	static constexpr bool allowed(state_t from, state_t to)
+	{
+		return TransitionTable[(uint8_t)from][(uint8_t)to];
+	}
+
 private:
-	const uint8_t TransitionTable[(uint8_t)state_t::COUNT][(uint8_t)state_t::COUNT] = {
+	// Shared by all the instances
+	static constexpr uint8_t TransitionTable[(uint8_t)state_t::COUNT][(uint8_t)state_t::COUNT] = {
 		// clang-format off
 		// Desired state
 	  // 0  1  2  3  4    // current state
@@ -1,4 +1,4 @@
-#include <cpp-utils/StateMachine.h>
+#include "statemachine.h"
 
 // template <class T>
 // thread_local bool _STATEMACHINE<T>::Transition::in_transition = false;
@@ -3,8 +3,21 @@
 #include <stdint.h>
 
 #include <cassert>
+#include <expected>
+#include <functional>
 #include <mutex>
 
+enum class TransitionError : uint8_t {
+	invalid = 1,  // the transition table doesn't allow it
+	reentrant	  // transition within transition on the same thread
+};
+
+enum class TransitionPhase : uint8_t {
+	begin = 1,
+	commit,
+	revert
+};
+
 template <class T>
 class _STATEMACHINE
 {
@@ -12,6 +25,9 @@ public:
 	using state_t = T;
 	class Transition;
 
+	// Called under the state machine lock, must not transit
+	using observer_t = std::function<void(state_t from, state_t to, TransitionPhase phase)>;
+
 	_STATEMACHINE(const uint8_t* TransitionTable, state_t startState)
 		: m_CurrentState(startState),
 		  m_NextState(startState),
@@ -26,6 +42,12 @@ public:
 		return m_CurrentState;
 	}
 
+	// Set before the first transition, the observer isn't guarded against running transitions
+	void observe(observer_t observer)
+	{
+		m_Observer = std::move(observer);
+	}
+
 	bool validate_transition(state_t newState)
 	{
 		uint32_t transition = (uint8_t)m_CurrentState * (uint8_t)state_t::COUNT + (uint8_t)newState;
@@ -34,33 +56,53 @@ public:
 
 	// Cannot start transition within transition, the transition finished
 	// when the transition object is out of scope.
-	Transition transit(state_t state)
+	std::expected<Transition, TransitionError> try_transit(state_t state)
 	{
 		// same thread reenter will cause a deadlock
 		if (in_transition && Transition::in_transition) {
-			throw "Transition within transition";
+			return std::unexpected(TransitionError::reentrant);
+		}
+
+		std::unique_lock<std::mutex> lock(m_Mtx);
+		if (!validate_transition(state)) {
+			return std::unexpected(TransitionError::invalid);
 		}
-		return Transition(*this, state);
+
+		return Transition(*this, std::move(lock), state);
 	}
 
-protected:
-	class Transition : private std::lock_guard<std::mutex>
+	// Throwing variant of try_transit
+	Transition transit(state_t state)
 	{
-	public:
-		using base_t = std::lock_guard<std::mutex>;
+		auto t = try_transit(state);
+		if (!t) {
+			throw t.error() == TransitionError::reentrant ? "Transition within transition" : "Invalid transition";
+		}
+		return std::move(*t);
+	}
 
-		Transition(_STATEMACHINE& sm, state_t newState) : base_t(sm.m_Mtx), m_SM(sm)
+	class Transition
+	{
+	public:
+		Transition(Transition&& other) noexcept
+			: m_Lock(std::move(other.m_Lock)), m_SM(other.m_SM), m_Commited(other.m_Commited)
 		{
-			if (!m_SM.validate_transition(newState)) {
-				throw "Invalid transition";
-			}
-			in_transition	   = true;
-			m_SM.in_transition = true;
-			// printf("start transition\n");
-			m_SM.m_NextState = newState;
 		}
+
+		Transition& operator=(Transition&&) = delete;
+
 		~Transition()
 		{
+			if (!m_Lock.owns_lock()) {
+				return;	 // moved from
+			}
+
+			if (m_SM.m_Observer) {
+				m_SM.m_Observer(m_SM.m_CurrentState,
+								m_SM.m_NextState,
+								m_Commited ? TransitionPhase::commit : TransitionPhase::revert);
+			}
+
 			if (m_Commited) {
 				// printf("Finish transition\n");
 				m_SM.m_CurrentState = m_SM.m_NextState;
@@ -79,8 +121,23 @@ protected:
 		}
 
 	private:
-		bool m_Commited = false;
+		// Called with the state machine locked and the transition validated
+		Transition(_STATEMACHINE& sm, std::unique_lock<std::mutex> lock, state_t newState)
+			: m_Lock(std::move(lock)), m_SM(sm)
+		{
+			in_transition	   = true;
+			m_SM.in_transition = true;
+			// printf("start transition\n");
+			m_SM.m_NextState = newState;
+
+			if (m_SM.m_Observer) {
+				m_SM.m_Observer(m_SM.m_CurrentState, newState, TransitionPhase::begin);
+			}
+		}
+
+		std::unique_lock<std::mutex> m_Lock;
 		_STATEMACHINE& m_SM;
+		bool m_Commited = false;
 		thread_local static inline bool in_transition = false;
 		friend _STATEMACHINE;
 	};
@@ -90,6 +147,7 @@ private:
 	state_t m_CurrentState;
 	state_t m_NextState;
 	const uint8_t* const m_TransitionTable;
+	observer_t m_Observer;
 
 	// instance indicator
 	bool in_transition = false;
@@ -0,0 +1,175 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CommandChannel.h"
+#include "harness.h"
+
+namespace
+{
+constexpr uint32_t echo	   = 1;
+constexpr uint32_t reverse = 2;
+
+std::wstring pipe_name(std::wstring_view name)
+{
+	return L"wsf_test_" + std::to_wstring(GetCurrentProcessId()) + L"_" + std::wstring(name);
+}
+
+// The server claims the name on its own thread, retry until it did
+bool connect(CommandClient& client, std::wstring_view name)
+{
+	for (int attempt = 0; attempt < 500; attempt++, Sleep(10)) {
+		if (client.connect(name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void serve(CommandServer& server, std::vector<std::jthread>& threads, const std::wstring& name,
+		   uint32_t count)
+{
+	server.on(echo, [](std::span<const uint8_t> payload) {
+		return std::vector<uint8_t>(payload.begin(), payload.end());
+	});
+	server.on(reverse, [](std::span<const uint8_t> payload) {
+		return std::vector<uint8_t>(payload.rbegin(), payload.rend());
+	});
+	for (uint32_t i = 0; i < count; i++) {
+		threads.emplace_back([&server, name](std::stop_token token) { server.serve(name, token); });
+	}
+}
+
+std::vector<uint8_t> bytes(std::string_view text)
+{
+	return {text.begin(), text.end()};
+}
+}  // namespace
+
+TEST(command_call_round_trips)
+{
+	auto name = pipe_name(L"call");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, 1);
+
+	CommandClient client;
+	REQUIRE(connect(client, name));
+	CommandReply reply;
+	REQUIRE(client.call(echo, bytes("ping"), reply));
+	CHECK(reply.status == NO_ERROR);
+	CHECK(reply.payload == bytes("ping"));
+
+	// Unknown commands are answered, not dropped
+	REQUIRE(client.call(42, bytes("ping"), reply));
+	CHECK(reply.status == ERROR_CALL_NOT_IMPLEMENTED);
+	CHECK(reply.payload.empty());
+	client.close();
+}
+
+TEST(command_batch_replies_in_the_queued_order)
+{
+	auto name = pipe_name(L"batch");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, 1);
+
+	CommandClient client;
+	REQUIRE(connect(client, name));
+	client.queue(echo, bytes("abc"));
+	client.queue(42, {});
+	client.queue(reverse, bytes("abc"));
+
+	std::vector<CommandReply> replies;
+	REQUIRE(client.flush(replies));
+	REQUIRE(replies.size() == 3);
+	CHECK(replies[0].status == NO_ERROR && replies[0].payload == bytes("abc"));
+	CHECK(replies[1].status == ERROR_CALL_NOT_IMPLEMENTED);
+	CHECK(replies[2].status == NO_ERROR && replies[2].payload == bytes("cba"));
+
+	// The batch is emptied by the flush
+	REQUIRE(client.flush(replies));
+	CHECK(replies.empty());
+	client.close();
+}
+
+TEST(command_refusal_answers_with_its_status)
+{
+	auto name = pipe_name(L"refuse");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, 1);
+
+	CommandClient client;
+	REQUIRE(connect(client, name));
+	CommandReply reply;
+	server.refuse(ERROR_SERVICE_CANNOT_ACCEPT_CTRL);
+	REQUIRE(client.call(echo, bytes("ping"), reply));
+	CHECK(reply.status == ERROR_SERVICE_CANNOT_ACCEPT_CTRL);
+
+	server.refuse(NO_ERROR);
+	REQUIRE(client.call(echo, bytes("ping"), reply));
+	CHECK(reply.status == NO_ERROR && reply.payload == bytes("ping"));
+	client.close();
+}
+
+TEST(command_server_serves_several_clients_at_once)
+{
+	auto name = pipe_name(L"instances");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, CommandServer::default_instances);
+
+	// All connected before any call, a single instance would leave the others busy
+	std::vector<CommandClient> clients(CommandServer::default_instances);
+	for (auto& client : clients) {
+		REQUIRE(connect(client, name));
+	}
+	for (auto& client : clients) {
+		CommandReply reply;
+		CHECK(client.call(echo, bytes("ping"), reply) && reply.status == NO_ERROR);
+		client.close();
+	}
+}
+
+TEST(command_server_returns_on_stop)
+{
+	auto name = pipe_name(L"stop");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, 2);
+	Sleep(20);	// waiting for a client
+
+	auto begin = GetTickCount64();
+	threads.clear();  // request the stop and join
+	CHECK(GetTickCount64() - begin < 1000);
+}
+
+BENCH(command_pipe_throughput)
+{
+	auto name = pipe_name(L"bench");
+	CommandServer server;
+	std::vector<std::jthread> threads;
+	serve(server, threads, name, 1);
+
+	CommandClient client;
+	REQUIRE(connect(client, name));
+	auto payload = bytes("0123456789abcdef");
+	constexpr uint32_t commands = 100000;
+
+	for (uint32_t batch : {1u, 16u, 256u}) {
+		std::vector<CommandReply> replies;
+		auto begin = harness::now_us();
+		for (uint32_t sent = 0; sent < commands; sent += batch) {
+			for (uint32_t i = 0; i < batch; i++) {
+				client.queue(echo, payload);
+			}
+			REQUIRE(client.flush(replies));
+		}
+		auto elapsed = harness::now_us() - begin;
+
+		auto metric = "commands/s, batch of " + std::to_string(batch);
+		harness::report(metric.c_str(), commands * 1e6 / elapsed, "");
+	}
+	client.close();
+}
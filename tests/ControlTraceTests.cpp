@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ControlTrace.h"
+#include "HostedService.h"
+
+namespace
+{
+struct ReplayService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestReplay";
+	ReplayService() : HostedService(service_name) {}
+};
+
+// A storm of controls back to back, an interrogate is handled by the base alone
+bool write_storm(const std::wstring& path, uint32_t controls)
+{
+	ControlTrace trace;
+	if (!trace.create(path)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < controls; i++) {
+		auto control = i % 2 ? SERVICE_CONTROL_INTERROGATE : SERVICE_CONTROL_SESSIONCHANGE;
+		trace.write(ControlTrace::Kind::control, control, 0, i);
+	}
+	trace.close();
+	return trace.dropped() == 0;
+}
+
+size_t count(const std::vector<ControlTrace::Record>& records, ControlTrace::Kind kind)
+{
+	return std::count_if(records.begin(), records.end(), [kind](const ControlTrace::Record& record) {
+		return record.kind == kind;
+	});
+}
+}  // namespace
+
+TEST(trace_round_trips_its_records)
+{
+	auto path = harness::temp_path(L"roundtrip.trace");
+	{
+		ControlTrace trace;
+		REQUIRE(trace.create(path));
+		trace.write(ControlTrace::Kind::control, SERVICE_CONTROL_PAUSE, 0, 0);
+		trace.write(ControlTrace::Kind::status, SERVICE_PAUSED, NO_ERROR, 0);
+		trace.write(ControlTrace::Kind::control, SERVICE_CONTROL_SESSIONCHANGE, 5, 2);
+	}  // closed by the destructor
+
+	ControlTrace::Header header;
+	std::vector<ControlTrace::Record> records;
+	REQUIRE(ControlTrace::load(path, header, records));
+	DeleteFileW(path.c_str());
+
+	CHECK(header.magic == ControlTrace::magic && header.version == ControlTrace::version);
+	CHECK(header.frequency > 0);
+	REQUIRE(records.size() == 3);
+	CHECK(records[0].kind == ControlTrace::Kind::control && records[0].a == SERVICE_CONTROL_PAUSE);
+	CHECK(records[1].kind == ControlTrace::Kind::status && records[1].a == SERVICE_PAUSED);
+	CHECK(records[2].a == SERVICE_CONTROL_SESSIONCHANGE && records[2].b == 5 && records[2].c == 2);
+	CHECK(records[0].time <= records[1].time && records[1].time <= records[2].time);
+}
+
+TEST(trace_accounts_for_every_record)
+{
+	// The writers outrun the file, each record is either written or counted as dropped
+	auto path = harness::temp_path(L"dropped.trace");
+	constexpr uint32_t written = 2000000;
+	uint64_t dropped = 0;
+	{
+		ControlTrace trace;
+		REQUIRE(trace.create(path));
+		for (uint32_t i = 0; i < written; i++) {
+			trace.write(ControlTrace::Kind::control, SERVICE_CONTROL_INTERROGATE, 0, i);
+		}
+		trace.close();
+		dropped = trace.dropped();
+	}
+
+	ControlTrace::Header header;
+	std::vector<ControlTrace::Record> records;
+	REQUIRE(ControlTrace::load(path, header, records));
+	DeleteFileW(path.c_str());
+	CHECK(records.size() + dropped == written);
+}
+
+TEST(trace_load_rejects_another_file)
+{
+	auto path = harness::temp_path(L"other.trace");
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+	REQUIRE(file != INVALID_HANDLE_VALUE);
+	char text[64] = "not a control trace";
+	DWORD written = 0;
+	WriteFile(file, text, sizeof(text), &written, NULL);
+	CloseHandle(file);
+
+	ControlReplayer replayer;
+	CHECK(!replayer.load(path));
+	DeleteFileW(path.c_str());
+}
+
+TEST(replay_hosts_the_service_once_per_replay)
+{
+	auto path = harness::temp_path(L"storm.trace");
+	REQUIRE(write_storm(path, 1000));
+	ControlReplayer replayer;
+	REQUIRE(replayer.load(path));
+	DeleteFileW(path.c_str());
+
+	Hosted<ReplayService> svc;
+	auto recording = harness::temp_path(L"recorded.trace");
+	auto trace	   = std::make_shared<ControlTrace>();
+	REQUIRE(trace->create(recording));
+	svc->record(trace);
+
+	// Stopped at the end of the first replay, the second hosts it again
+	for (int replay = 0; replay < 2; replay++) {
+		auto stats = replayer.replay(*svc, 0);
+		CHECK(stats.controls == 1000);
+		CHECK(stats.max_dispatch <= stats.dispatch && stats.dispatch <= stats.duration);
+		CHECK(svc->state() == ServiceStates::stopped);
+	}
+
+	svc->record(nullptr);
+	trace->close();
+	ControlTrace::Header header;
+	std::vector<ControlTrace::Record> records;
+	REQUIRE(ControlTrace::load(recording, header, records));
+	DeleteFileW(recording.c_str());
+	CHECK(count(records, ControlTrace::Kind::control) == 2000);
+}
+
+TEST(replay_refuses_a_running_service)
+{
+	auto path = harness::temp_path(L"running.trace");
+	REQUIRE(write_storm(path, 10));
+	ControlReplayer replayer;
+	REQUIRE(replayer.load(path));
+	DeleteFileW(path.c_str());
+
+	Hosted<ReplayService> svc;
+	REQUIRE(svc.run());
+	CHECK(replayer.replay(*svc, 0).controls == 0);
+	CHECK(svc->state() == ServiceStates::running);
+}
+
+BENCH(replay_control_storm)
+{
+	constexpr uint32_t controls = 200000;
+	auto path = harness::temp_path(L"bench.trace");
+	REQUIRE(write_storm(path, controls));
+	ControlReplayer replayer;
+	REQUIRE(replayer.load(path));
+	DeleteFileW(path.c_str());
+
+	Hosted<ReplayService> svc;
+	auto report = [](const char* label, const ControlReplayer::Stats& stats) {
+		auto rate = stats.controls * 1e6 / stats.duration;
+		harness::report((std::string(label) + ", controls/s").c_str(), rate, "");
+		harness::report((std::string(label) + ", mean dispatch").c_str(),
+						stats.dispatch * 1e3 / stats.controls,
+						"ns");
+		harness::report((std::string(label) + ", max dispatch").c_str(), stats.max_dispatch, "us");
+	};
+
+	report("untraced", replayer.replay(*svc, 0));
+
+	// The handler only appends to the trace, the file is written off its thread
+	auto recording = harness::temp_path(L"bench_recorded.trace");
+	auto trace	   = std::make_shared<ControlTrace>();
+	REQUIRE(trace->create(recording));
+	svc->record(trace);
+	report("traced", replayer.replay(*svc, 0));
+	svc->record(nullptr);
+	trace->close();
+	DeleteFileW(recording.c_str());
+	harness::report("traced, dropped records", static_cast<double>(trace->dropped()), "");
+}
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CpuAccount.h"
+#include "HostedService.h"
+
+namespace
+{
+using Phase = CpuAccount::Phase;
+
+constexpr ULONGLONG ms = 10000;	 // 100ns units
+
+struct AccountedService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestAccounted";
+	AccountedService() : HostedService(service_name) {}
+};
+
+// Spin on the CPU for `duration` ms of wall time
+void burn(DWORD duration)
+{
+	volatile uint64_t sink = 0;
+	for (auto end = GetTickCount64() + duration; GetTickCount64() < end;) {
+		for (int i = 0; i < 10000; i++) {
+			sink = sink + i;
+		}
+	}
+}
+
+ULONGLONG total(const CpuAccount::Times& times)
+{
+	return times.user + times.kernel;
+}
+}  // namespace
+
+TEST(cpu_is_attributed_to_the_current_phase)
+{
+	CpuAccount account;
+	account.enter();
+	burn(200);
+	account.phase(Phase::running);
+	burn(200);
+	account.phase(Phase::stop);
+	account.leave();
+
+	// The thread times move by scheduler ticks, allow a few of them
+	CHECK(total(account.get(Phase::start)) >= 100 * ms);
+	CHECK(total(account.get(Phase::running)) >= 100 * ms);
+	CHECK(total(account.get(Phase::pause)) == 0);
+	CHECK(total(account.get(Phase::stop)) < 50 * ms);
+}
+
+TEST(cpu_before_enter_and_after_leave_isnt_accounted)
+{
+	CpuAccount account;
+	burn(200);
+	account.enter();
+	account.leave();
+	burn(200);
+	CHECK(total(account.get(Phase::start)) < 50 * ms);
+}
+
+TEST(cpu_of_a_running_thread_is_sampled_when_queried)
+{
+	CpuAccount account;
+	std::atomic<bool> entered{false}, done{false};
+	std::thread worker([&] {
+		account.enter();
+		entered = true;
+		burn(200);
+		while (!done) {
+			Sleep(1);
+		}
+		account.leave();
+	});
+
+	while (!entered) {
+		Sleep(1);
+	}
+	Sleep(250);
+	CHECK(total(account.get(Phase::start)) >= 100 * ms);  // still entered
+	done = true;
+	worker.join();
+}
+
+TEST(cpu_of_a_service_is_split_by_phase)
+{
+	// The workers are accounted, the test thread running the start isn't the SCM thread
+	Hosted<AccountedService> svc;
+	std::atomic<bool> started{false}, running{false};
+	svc->on_start = [&] {
+		svc->spawn([&](std::stop_token token) {
+			burn(200);
+			started = true;
+			while (!running) {
+				Sleep(1);
+			}
+			burn(200);
+			while (!token.stop_requested()) {
+				Sleep(1);
+			}
+		});
+		while (!started) {
+			Sleep(1);
+		}
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	running = true;
+	Sleep(300);
+	REQUIRE(svc.stop());
+
+	CHECK(total(svc->cpu_time(Phase::start)) >= 100 * ms);
+	CHECK(total(svc->cpu_time(Phase::running)) >= 100 * ms);
+	CHECK(total(svc->cpu_time(Phase::pause)) == 0);
+}
+
+// A phase change samples every entered thread
+BENCH(cpu_phase_change)
+{
+	constexpr int threads = 64, changes = 1000;
+	CpuAccount account;
+	std::atomic<int> entered{0};
+	std::atomic<bool> done{false};
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.emplace_back([&] {
+			account.enter();
+			entered++;
+			while (!done) {
+				Sleep(1);
+			}
+			account.leave();
+		});
+	}
+	while (entered < threads) {
+		Sleep(1);
+	}
+
+	auto begin = harness::now_us();
+	for (int i = 0; i < changes; i++) {
+		account.phase(i % 2 ? Phase::running : Phase::pause);
+	}
+	auto elapsed = harness::now_us() - begin;
+	done		 = true;
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	harness::report("phase change, 64 threads", static_cast<double>(elapsed) / changes, "us");
+	harness::report("sample per thread", elapsed * 1e3 / (changes * threads), "ns");
+}
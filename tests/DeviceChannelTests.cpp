@@ -0,0 +1,209 @@
+#include <Windows.h>
+#include <winioctl.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceChannel.h"
+#include "harness.h"
+
+// The device is the client end of a named pipe, FSCTL_PIPE_PEEK is a device control every pipe
+// implements without a driver. It completes at once, the data the server wrote stays in the pipe.
+namespace
+{
+// FILE_PIPE_PEEK_BUFFER of the DDK
+struct PeekHeader {
+	ULONG state;
+	ULONG available;
+	ULONG messages;
+	ULONG message_length;
+};
+
+class FakeDevice
+{
+public:
+	FakeDevice(std::string_view data)
+	{
+		m_Name = L"pipe\\wsf_test_device_" + std::to_wstring(GetCurrentProcessId());
+		m_Pipe = CreateNamedPipeW((L"\\\\.\\" + m_Name).c_str(),
+								  PIPE_ACCESS_DUPLEX,
+								  PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+								  1,
+								  4096,
+								  4096,
+								  0,
+								  NULL);
+		m_Data = data;
+	}
+
+	~FakeDevice()
+	{
+		if (m_Pipe != INVALID_HANDLE_VALUE) {
+			CloseHandle(m_Pipe);
+		}
+	}
+
+	const std::wstring& name() const
+	{
+		return m_Name;
+	}
+
+	// Once the channel opened the client end
+	bool write()
+	{
+		DWORD written = 0;
+		return (ConnectNamedPipe(m_Pipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED) &&
+			   WriteFile(m_Pipe, m_Data.data(), static_cast<DWORD>(m_Data.size()), &written, NULL);
+	}
+
+private:
+	std::wstring m_Name;
+	HANDLE m_Pipe = INVALID_HANDLE_VALUE;
+	std::string m_Data;
+};
+
+struct Reapers {
+	Reapers(DeviceChannel& channel, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			threads.emplace_back([&channel](std::stop_token token) { channel.reap(token); });
+		}
+	}
+
+	std::vector<std::jthread> threads;
+};
+
+bool wait_completed(DeviceChannel& channel, uint64_t count, DWORD timeout)
+{
+	for (auto deadline = GetTickCount64() + timeout; channel.completed() < count; Sleep(1)) {
+		if (GetTickCount64() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+}  // namespace
+
+TEST(device_calls_back_each_request)
+{
+	FakeDevice device("hello");
+	DeviceChannel channel;
+	REQUIRE(channel.open(device.name(), 8, 256));
+	REQUIRE(device.write());
+	Reapers reapers(channel, 2);
+
+	constexpr int requests = 100;
+	std::atomic<int> succeeded{0};
+	std::atomic<bool> data{true};
+	DeviceChannel::Request peek{FSCTL_PIPE_PEEK, {}, 256, [&](DWORD error, std::span<const uint8_t> output) {
+		if (error == NO_ERROR && output.size() == sizeof(PeekHeader) + 5) {
+			auto header = reinterpret_cast<const PeekHeader*>(output.data());
+			data		= data && header->available == 5 &&
+					 std::string_view(reinterpret_cast<const char*>(output.data()) + sizeof(PeekHeader), 5) ==
+						 "hello";
+			succeeded++;
+		}
+	}};
+
+	for (int i = 0; i < requests; i++) {
+		REQUIRE(channel.submit(peek, 5000));
+	}
+	CHECK(wait_completed(channel, requests, 5000));
+	CHECK(succeeded == requests);
+	CHECK(data);
+	CHECK(channel.in_flight() == 0);
+	channel.close();
+}
+
+TEST(device_refusals_dont_call_back)
+{
+	FakeDevice device("hello");
+	DeviceChannel channel;
+	REQUIRE(channel.open(device.name(), 4, 64));
+	Reapers reapers(channel, 1);
+
+	bool called = false;
+	auto done	= [&called](DWORD, std::span<const uint8_t>) { called = true; };
+	std::vector<uint8_t> large(65);
+	CHECK(!channel.submit({FSCTL_PIPE_PEEK, large, 16, done}));	 // larger than the buffers
+	CHECK(!channel.submit({FSCTL_PIPE_PEEK, {}, 65, done}));
+
+	constexpr DWORD unknown = CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS);
+	CHECK(!channel.submit({unknown, {}, 16, done}));  // no pipe implements it
+	Sleep(50);
+	CHECK(!called);
+	CHECK(channel.in_flight() == 0);
+	channel.close();
+}
+
+TEST(device_warning_completions_release_their_slot_once)
+{
+	FakeDevice device("hello");
+	DeviceChannel channel;
+	REQUIRE(channel.open(device.name(), 4, 64));
+	REQUIRE(device.write());
+	Reapers reapers(channel, 2);
+
+	// Room for 2 of the 5 bytes, the peek completes with ERROR_MORE_DATA through the port
+	constexpr int requests = 1000;
+	std::atomic<int> more{0};
+	DeviceChannel::Request peek{FSCTL_PIPE_PEEK, {}, sizeof(PeekHeader) + 2, [&more](DWORD error, auto) {
+		more += error == ERROR_MORE_DATA;
+	}};
+	for (int i = 0; i < requests; i++) {
+		REQUIRE(channel.submit(peek, 5000));
+	}
+
+	CHECK(wait_completed(channel, requests, 5000));
+	CHECK(more == requests);
+	CHECK(channel.in_flight() == 0);
+	channel.close();
+}
+
+TEST(device_close_returns_with_the_reapers_waiting)
+{
+	FakeDevice device("hello");
+	DeviceChannel channel;
+	REQUIRE(channel.open(device.name()));
+	Reapers reapers(channel, 4);
+	Sleep(20);	// parked on the port
+
+	auto begin = GetTickCount64();
+	CHECK(channel.close(1000));	 // nothing held
+	CHECK(GetTickCount64() - begin < 1000);
+	for (auto& thread : reapers.threads) {
+		thread.join();	// returned on the close, not on the token
+	}
+}
+
+BENCH(device_requests_per_second)
+{
+	FakeDevice device("hello");
+	DeviceChannel channel;
+	REQUIRE(channel.open(device.name(), 64, 256));
+	REQUIRE(device.write());
+	Reapers reapers(channel, 2);
+
+	constexpr int requests = 500000, batch = 32;
+	DeviceChannel::Request peek{FSCTL_PIPE_PEEK, {}, 256, [](DWORD, std::span<const uint8_t>) {}};
+	std::vector<DeviceChannel::Request> requestsBatch(batch, peek);
+
+	auto begin = harness::now_us();
+	for (int i = 0; i < requests; i++) {
+		channel.submit(peek);
+	}
+	REQUIRE(wait_completed(channel, requests, 60000));
+	auto elapsed = harness::now_us() - begin;
+	harness::report("requests/s, one at a time", requests * 1e6 / elapsed, "");
+
+	begin = harness::now_us();
+	for (int i = 0; i < requests; i += batch) {
+		channel.submit(requestsBatch);
+	}
+	REQUIRE(wait_completed(channel, 2 * requests, 60000));
+	elapsed = harness::now_us() - begin;
+	harness::report("requests/s, batches of 32", requests * 1e6 / elapsed, "");
+	channel.close();
+}
@@ -0,0 +1,61 @@
+#include "HostedService.h"
+
+namespace
+{
+struct FirstService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestFirst";
+	FirstService() : HostedService(service_name) {}
+};
+
+struct SecondService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestSecond";
+	SecondService() : HostedService(service_name) {}
+};
+}  // namespace
+
+TEST(dispatcher_generates_the_entry_points_per_type)
+{
+	Hosted<FirstService> first;
+	Hosted<SecondService> second;
+
+	CHECK(first->cfg.function_main != nullptr);
+	CHECK(first->cfg.function_handler_ex != nullptr);
+	CHECK(first->cfg.function_main != second->cfg.function_main);
+	CHECK(first->cfg.function_handler_ex == second->cfg.function_handler_ex);  // the context differs
+
+	// Adding again keeps the instance
+	SCMDispatcher::instance()->add<FirstService>();
+	CHECK(SCMDispatcher::instance()->get<FirstService>().get() == &*first);
+}
+
+TEST(dispatcher_handler_reaches_the_service_through_its_context)
+{
+	Hosted<FirstService> svc;
+	auto handler = svc->cfg.function_handler_ex;
+	CHECK(handler(SERVICE_CONTROL_INTERROGATE, 0, nullptr, &*svc) == NO_ERROR);
+	CHECK(handler(200, 0, nullptr, &*svc) == ERROR_CALL_NOT_IMPLEMENTED);  // a user defined control
+}
+
+TEST(dispatcher_forgets_removed_services)
+{
+	{
+		Hosted<FirstService> svc;
+		CHECK(SCMDispatcher::instance()->get(FirstService::service_name) != nullptr);
+	}
+	CHECK(SCMDispatcher::instance()->get<FirstService>() == nullptr);
+	CHECK(!SCMDispatcher::instance()->run<FirstService>());
+}
+
+BENCH(dispatcher_control_dispatch)
+{
+	constexpr int iterations = 1000000;
+	Hosted<FirstService> svc;
+	auto handler = svc->cfg.function_handler_ex;
+
+	auto begin = harness::now_us();
+	for (int i = 0; i < iterations; i++) {
+		handler(SERVICE_CONTROL_INTERROGATE, 0, nullptr, &*svc);
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("interrogate dispatch", elapsed * 1e3 / iterations, "ns");
+}
@@ -0,0 +1,86 @@
+#include <atomic>
+
+#include "HostedService.h"
+
+namespace
+{
+struct DrainService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestDrain";
+	DrainService() : HostedService(service_name) {}
+};
+
+bool wait_until(const std::atomic<bool>& flag, DWORD timeout)
+{
+	for (auto deadline = GetTickCount64() + timeout; !flag.load(); Sleep(1)) {
+		if (GetTickCount64() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+}  // namespace
+
+TEST(drain_stops_workers_through_their_token)
+{
+	Hosted<DrainService> svc;
+	std::atomic<uint32_t> exited{0};
+	svc->on_start = [&] {
+		for (int i = 0; i < 4; i++) {
+			svc->spawn([&exited](std::stop_token token) {
+				while (!token.stop_requested()) {
+					Sleep(1);
+				}
+				exited++;
+			});
+		}
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	CHECK(svc->state() == ServiceStates::running);
+	REQUIRE(svc.stop());
+	CHECK(svc->state() == ServiceStates::stopped);
+	CHECK(exited == 4);
+	CHECK(svc->shutdown_latency() < 1000);
+}
+
+TEST(drain_detaches_a_worker_past_the_deadline)
+{
+	Hosted<DrainService> svc;
+	std::atomic<bool> release{false}, exited{false};
+	svc->cfg.drain_timeout = 200;
+	svc->on_start = [&] {
+		svc->spawn([&](std::stop_token) {
+			wait_until(release, INFINITE);	// ignores its token
+			exited = true;
+		});
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	REQUIRE(svc.stop());
+	CHECK(svc->state() == ServiceStates::stopped);
+	CHECK(svc->shutdown_latency() >= 200 && svc->shutdown_latency() < 2000);
+	CHECK(!exited);
+
+	// The detached worker exits on its own, before the service goes away
+	release = true;
+	CHECK(wait_until(exited, 5000));
+}
+
+TEST(drain_doesnt_join_the_stopping_worker)
+{
+	Hosted<DrainService> svc;
+	std::atomic<bool> stopped{false};
+	svc->on_start = [&] {
+		svc->spawn([&](std::stop_token) {
+			SCMDispatcher::instance()->stop<DrainService>();
+			stopped = true;
+		});
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	CHECK(wait_until(stopped, 5000));
+	CHECK(svc->state() == ServiceStates::stopped);
+}
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ControlTrace.h"
+#include "EventBus.h"
+#include "HostedService.h"
+
+namespace
+{
+bool wait_until(const std::atomic<uint32_t>& count, uint32_t expected, DWORD timeout)
+{
+	for (auto deadline = GetTickCount64() + timeout; count.load() < expected; Sleep(1)) {
+		if (GetTickCount64() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Holds the replay on the interrogate ending the trace until the events before it were delivered,
+// the replay stops the service, and the delivery with it, right after the last control
+struct EventService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestEvents";
+	EventService() : HostedService(service_name) {}
+
+	std::atomic<uint32_t> delivered{0};
+	uint32_t expected = 0;
+
+private:
+	void __stdcall handler(DWORD control) override
+	{
+		if (control == SERVICE_CONTROL_INTERROGATE) {
+			wait_until(delivered, expected, 5000);
+		}
+	}
+};
+}  // namespace
+
+TEST(event_channel_publishes_to_the_current_subscribers)
+{
+	EventChannel<SessionEvent> channel;
+	int first = 0, second = 0;
+	auto id = channel.subscribe([&first](const SessionEvent&) { first++; });
+	channel.subscribe([&second](const SessionEvent&) { second++; });
+
+	channel.publish({WTS_SESSION_LOCK, 1});
+	channel.unsubscribe(id);
+	channel.publish({WTS_SESSION_UNLOCK, 1});
+	CHECK(first == 1);
+	CHECK(second == 2);
+}
+
+TEST(event_channel_callback_may_unsubscribe_itself)
+{
+	EventChannel<SessionEvent> channel;
+	int calls = 0;
+	uint32_t id = 0;
+	id = channel.subscribe([&](const SessionEvent&) {
+		calls++;
+		channel.unsubscribe(id);  // the publish holds the list it iterates
+	});
+
+	channel.publish({WTS_SESSION_LOCK, 1});
+	channel.publish({WTS_SESSION_LOCK, 1});
+	CHECK(calls == 1);
+}
+
+TEST(event_bus_delivers_in_posting_order)
+{
+	EventBus bus;
+	std::vector<DWORD> sessions;
+	std::atomic<uint32_t> delivered{0}, powered{0};
+	bus.subscribe<SessionEvent>([&](const SessionEvent& event) {
+		sessions.push_back(event.session_id);
+		delivered++;
+	});
+	bus.subscribe<PowerEvent>([&](const PowerEvent&) { powered++; });
+
+	std::jthread worker([&bus](std::stop_token token) { bus.deliver(token); });
+	for (DWORD i = 0; i < 1000; i++) {
+		bus.post(SessionEvent{WTS_SESSION_LOCK, i});
+	}
+	bus.post(PowerEvent{PBT_POWERSETTINGCHANGE, {}, {}});
+
+	REQUIRE(wait_until(delivered, 1000, 5000));
+	CHECK(wait_until(powered, 1, 5000));
+	worker.request_stop();
+	worker.join();
+
+	bool ordered = true;
+	for (DWORD i = 0; i < sessions.size(); i++) {
+		ordered = ordered && sessions[i] == i;
+	}
+	CHECK(ordered);
+}
+
+TEST(event_bus_stops_delivering_on_request)
+{
+	EventBus bus;
+	std::jthread worker([&bus](std::stop_token token) { bus.deliver(token); });
+	Sleep(10);	// parked in the wait
+
+	auto begin = GetTickCount64();
+	worker.request_stop();
+	worker.join();
+	CHECK(GetTickCount64() - begin < 1000);
+}
+
+TEST(handler_ex_posts_the_session_changes_to_the_bus)
+{
+	auto path = harness::temp_path(L"events.trace");
+	{
+		ControlTrace trace;
+		REQUIRE(trace.create(path));
+		for (uint32_t session = 1; session <= 3; session++) {
+			auto control = SERVICE_CONTROL_SESSIONCHANGE;
+			trace.write(ControlTrace::Kind::control, control, WTS_SESSION_LOCK, session);
+		}
+		trace.write(ControlTrace::Kind::control, SERVICE_CONTROL_INTERROGATE, 0, 0);
+		trace.close();
+	}
+
+	Hosted<EventService> svc;
+	std::vector<DWORD> sessions;
+	svc->expected = 3;
+	svc->events.subscribe<SessionEvent>([&](const SessionEvent& event) {
+		sessions.push_back(event.session_id);
+		svc->delivered++;
+	});
+
+	ControlReplayer replayer;
+	REQUIRE(replayer.load(path));
+	auto stats = replayer.replay(*svc, 0);
+	DeleteFileW(path.c_str());
+
+	CHECK(stats.controls == 4);
+	CHECK(svc->delivered == 3);
+	CHECK(sessions == std::vector<DWORD>({1, 2, 3}));
+	CHECK(svc->state() == ServiceStates::stopped);
+}
@@ -0,0 +1,273 @@
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuAccount.h"
+#include "FairScheduler.h"
+#include "HostedService.h"
+
+namespace
+{
+struct TaskService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestTasks";
+	TaskService() : HostedService(service_name) {}
+};
+
+// Spin on the CPU for `duration` us
+void burn(int64_t duration)
+{
+	for (auto end = harness::now_us() + duration; harness::now_us() < end;) {
+	}
+}
+
+// Keeps its queue saturated with `chains` tasks of `cost` us resubmitting themselves until stopped
+struct Saturate {
+	Saturate(FairScheduler& scheduler,
+			 std::shared_ptr<FairScheduler::Queue> queue,
+			 int64_t cost,
+			 unsigned chains = 4)
+		: scheduler(scheduler), queue(std::move(queue)), cost(cost)
+	{
+		for (unsigned i = 0; i < chains; i++) {
+			submit();
+		}
+	}
+
+	void submit()
+	{
+		scheduler.submit(queue, [this] {
+			burn(cost);
+			if (!stopped) {
+				submit();
+			}
+		});
+	}
+
+	FairScheduler& scheduler;
+	std::shared_ptr<FairScheduler::Queue> queue;
+	int64_t cost;
+	std::atomic<bool> stopped{false};
+};
+}  // namespace
+
+TEST(scheduler_shares_a_class_by_weight)
+{
+	FairScheduler scheduler;
+	scheduler.start(1);
+	auto light = scheduler.attach(TaskClass::normal, 1);
+	auto heavy = scheduler.attach(TaskClass::normal, 3);
+
+	Saturate a(scheduler, light, 200), b(scheduler, heavy, 200);
+	Sleep(500);
+	a.stopped = b.stopped = true;
+	CHECK(scheduler.detach(*light, 5000));
+	CHECK(scheduler.detach(*heavy, 5000));
+
+	double ratio = static_cast<double>(heavy->metrics().run_time) / light->metrics().run_time;
+	CHECK(ratio > 2 && ratio < 4);
+	scheduler.stop();
+}
+
+TEST(scheduler_serves_the_classes_in_order)
+{
+	FairScheduler scheduler;
+	scheduler.start(1);
+	auto gate		= scheduler.attach(TaskClass::normal, 1);
+	auto background = scheduler.attach(TaskClass::background, 1);
+	auto normal		= scheduler.attach(TaskClass::normal, 1);
+	auto high		= scheduler.attach(TaskClass::high, 1);
+
+	// The worker is held while the tasks of every class queue up
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::atomic<bool> entered{false};
+	scheduler.submit(gate, [&] {
+		entered = true;
+		released.wait();
+	});
+	while (!entered) {
+		Sleep(1);
+	}
+
+	std::mutex mtx;
+	std::vector<TaskClass> order;
+	auto record = [&](TaskClass taskClass) {
+		return [&, taskClass] {
+			std::lock_guard<std::mutex> g(mtx);
+			order.push_back(taskClass);
+		};
+	};
+	scheduler.submit(background, record(TaskClass::background));
+	scheduler.submit(normal, record(TaskClass::normal));
+	scheduler.submit(high, record(TaskClass::high));
+	release.set_value();
+
+	for (auto deadline = GetTickCount64() + 5000; background->metrics().executed == 0; Sleep(1)) {
+		REQUIRE(GetTickCount64() < deadline);
+	}
+	std::lock_guard<std::mutex> g(mtx);
+	CHECK((order == std::vector{TaskClass::high, TaskClass::normal, TaskClass::background}));
+	scheduler.stop();
+}
+
+TEST(scheduler_restores_the_worker_after_a_placed_queue)
+{
+	FairScheduler scheduler;
+	scheduler.start(1);
+
+	TaskHooks hooks;
+	hooks.enter	 = [] { SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST); };
+	hooks.placed = true;
+	auto placed	 = scheduler.attach(TaskClass::normal, 1, std::move(hooks));
+	auto plain	 = scheduler.attach(TaskClass::normal, 1);
+
+	std::promise<int> inside, after;
+	scheduler.submit(placed, [&] { inside.set_value(GetThreadPriority(GetCurrentThread())); });
+	CHECK(inside.get_future().get() == THREAD_PRIORITY_LOWEST);
+	scheduler.submit(plain, [&] { after.set_value(GetThreadPriority(GetCurrentThread())); });
+	CHECK(after.get_future().get() == THREAD_PRIORITY_NORMAL);
+	scheduler.stop();
+}
+
+TEST(scheduler_detach_drops_the_pending_tasks)
+{
+	FairScheduler scheduler;
+	scheduler.start(1);
+	auto queue = scheduler.attach(TaskClass::normal, 1);
+
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::atomic<bool> entered{false};
+	scheduler.submit(queue, [&] {
+		entered = true;
+		released.wait();
+	});
+	while (!entered) {
+		Sleep(1);
+	}
+	for (int i = 0; i < 10; i++) {
+		scheduler.submit(queue, [] {});
+	}
+
+	CHECK(!scheduler.detach(*queue, 50));  // the running task is waited
+	release.set_value();
+	CHECK(scheduler.detach(*queue, 5000));
+	CHECK(!scheduler.submit(queue, [] {}));
+	CHECK(queue->metrics().executed == 1);
+	CHECK(queue->metrics().dropped == 10);
+	scheduler.stop();
+}
+
+TEST(scheduler_stop_counts_the_taken_tasks_as_dropped)
+{
+	FairScheduler scheduler;
+	scheduler.start(1);
+	auto gate  = scheduler.attach(TaskClass::normal, 1);
+	auto queue = scheduler.attach(TaskClass::normal, 1);
+
+	// The worker takes the 10 tasks as a batch once the gate releases it, and blocks in the first
+	std::promise<void> open, release;
+	auto opened = open.get_future().share(), released = release.get_future().share();
+	std::atomic<bool> entered{false}, blocked{false};
+	scheduler.submit(gate, [&] {
+		entered = true;
+		opened.wait();
+	});
+	while (!entered) {
+		Sleep(1);
+	}
+	scheduler.submit(queue, [&] {
+		blocked = true;
+		released.wait();
+	});
+	for (int i = 0; i < 9; i++) {
+		scheduler.submit(queue, [] {});
+	}
+	open.set_value();
+	while (!blocked) {
+		Sleep(1);
+	}
+
+	std::jthread releasing([&release] {
+		Sleep(50);
+		release.set_value();
+	});
+	scheduler.stop();  // the worker stops after the running task
+	CHECK(queue->metrics().executed == 1);
+	CHECK(queue->metrics().dropped == 9);
+}
+
+TEST(scheduler_task_runs_under_the_service_placement_and_account)
+{
+	Hosted<TaskService> svc;
+	svc->cfg.placement.priority = THREAD_PRIORITY_BELOW_NORMAL;
+	REQUIRE(svc.run());
+
+	std::promise<int> priority;
+	REQUIRE(svc->submit([&] {
+		priority.set_value(GetThreadPriority(GetCurrentThread()));
+		burn(150000);
+	}));
+	CHECK(priority.get_future().get() == THREAD_PRIORITY_BELOW_NORMAL);
+	REQUIRE(svc.stop());
+
+	auto running = svc->cpu_time(CpuAccount::Phase::running);
+	CHECK(running.user + running.kernel >= 100 * 10000);  // 100ns units
+	CHECK(svc->task_metrics().executed == 1);
+	CHECK(!svc->submit([] {}));
+}
+
+TEST(scheduler_task_stops_its_own_service)
+{
+	Hosted<TaskService> svc;
+	REQUIRE(svc.run());
+
+	std::promise<bool> stopped;
+	auto result = stopped.get_future();
+	REQUIRE(svc->submit([&] { stopped.set_value(SCMDispatcher::instance()->stop<TaskService>()); }));
+	REQUIRE(result.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+	CHECK(result.get());
+	CHECK(svc->state() == ServiceStates::stopped);
+}
+
+// us from the submit until the task started, alone and against a saturating queue of the class
+BENCH(scheduler_task_latency)
+{
+	FairScheduler scheduler;
+	scheduler.start();
+	constexpr int tasks = 20000;
+
+	auto measure = [&](const char* metric) {
+		auto queue = scheduler.attach(TaskClass::normal, 1);
+		for (int i = 0; i < tasks; i++) {
+			scheduler.submit(queue, [] {});
+			if (i % 16 == 0) {
+				burn(50);  // paced, not a single burst
+			}
+		}
+		while (queue->metrics().executed < tasks) {
+			Sleep(1);
+		}
+		scheduler.detach(*queue, INFINITE);
+
+		auto metrics = queue->metrics();
+		auto mean	 = static_cast<double>(metrics.delay_total) / std::max<uint64_t>(metrics.executed, 1);
+		auto max	 = static_cast<double>(metrics.delay_max);
+		harness::report((std::string(metric) + ", mean").c_str(), mean, "us");
+		harness::report((std::string(metric) + ", max").c_str(), max, "us");
+	};
+
+	measure("idle");
+
+	auto busy = scheduler.attach(TaskClass::normal, 1);
+	{
+		Saturate saturate(scheduler, busy, 500, 2 * std::thread::hardware_concurrency());
+		measure("against a saturating queue");
+		saturate.stopped = true;
+		scheduler.detach(*busy, INFINITE);
+	}
+	scheduler.stop();
+}
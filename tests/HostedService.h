@@ -0,0 +1,106 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "framework.h"
+#include "harness.h"
+
+// A service run by the test process itself, never registered with the SCM.
+// Its status reports fail without a status handle. Elevated, the wait hints it saves on stop go under
+// its name in the services key, the key is deleted with it.
+// Derive with a `static inline const wchar_t* service_name` and drive it through Hosted<T>.
+class HostedService : public Service
+{
+public:
+	HostedService(const wchar_t* name)
+	{
+		cfg.configuration.lpServiceName = name;
+		s.transit(ServiceStates::installed).commit();
+	}
+
+	~HostedService()
+	{
+		auto key = L"SYSTEM\\CurrentControlSet\\Services\\" + std::wstring(cfg.configuration.lpServiceName);
+		RegDeleteTreeW(HKEY_LOCAL_MACHINE, key.c_str());
+	}
+
+	ServiceStates state()
+	{
+		return s.get_state();
+	}
+
+	// The overrides, true when unset
+	std::function<bool()> on_start;
+	std::function<bool()> on_stop;
+
+	using Service::cfg;
+	using Service::checkpoint;
+	using Service::events;
+	using Service::memory;
+	using Service::spawn;
+	using Service::stop_token;
+	using Service::submit;
+	using Service::timers;
+	using Service::watchdog;
+
+private:
+	bool start() override
+	{
+		return on_start ? on_start() : true;
+	}
+
+	bool stop() override
+	{
+		return on_stop ? on_stop() : true;
+	}
+};
+
+// Registers T with the dispatcher for the scope, the framework runs its transitions as for the SCM
+template <is_service_t T>
+class Hosted
+{
+public:
+	Hosted()
+	{
+		SCMDispatcher::instance()->add<T>();
+		m_Service = std::static_pointer_cast<T>(SCMDispatcher::instance()->get<T>());
+	}
+
+	~Hosted()
+	{
+		stop();
+		SCMDispatcher::instance()->remove<T>();
+	}
+
+	T* operator->()
+	{
+		return m_Service.get();
+	}
+
+	T& operator*()
+	{
+		return *m_Service;
+	}
+
+	bool run()
+	{
+		return SCMDispatcher::instance()->run<T>();
+	}
+
+	bool stop()
+	{
+		return SCMDispatcher::instance()->stop<T>();
+	}
+
+	bool pause()
+	{
+		return SCMDispatcher::instance()->pause<T>();
+	}
+
+private:
+	std::shared_ptr<T> m_Service;
+};
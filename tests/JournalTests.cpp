@@ -0,0 +1,171 @@
+#include <string>
+
+#include "Journal.h"
+#include "harness.h"
+#include "service_sm.h"
+
+namespace
+{
+void transition(Journal& journal, ServiceStates from, ServiceStates to, bool commit = true)
+{
+	auto a = static_cast<uint8_t>(from), b = static_cast<uint8_t>(to);
+	journal.append(a, b, TransitionPhase::begin);
+	if (commit) {
+		journal.append(a, b, TransitionPhase::commit);
+	}
+}
+
+uint8_t state(ServiceStates state)
+{
+	return static_cast<uint8_t>(state);
+}
+}  // namespace
+
+TEST(journal_recovers_the_last_committed_state)
+{
+	auto path = harness::temp_path(L"committed.journal");
+	{
+		Journal journal;
+		REQUIRE(journal.open(path));
+		CHECK(!journal.recovery().found);
+		transition(journal, ServiceStates::installed, ServiceStates::running);
+		transition(journal, ServiceStates::running, ServiceStates::paused);
+	}
+
+	Journal journal;
+	REQUIRE(journal.open(path));
+	auto& recovery = journal.recovery();
+	CHECK(recovery.found);
+	CHECK(!recovery.interrupted);
+	CHECK(recovery.state == state(ServiceStates::paused));
+	journal.close();
+	DeleteFileW(path.c_str());
+}
+
+TEST(journal_reverts_an_interrupted_transition_once)
+{
+	auto path = harness::temp_path(L"interrupted.journal");
+	{
+		Journal journal;
+		REQUIRE(journal.open(path));
+		transition(journal, ServiceStates::installed, ServiceStates::running);
+		transition(journal, ServiceStates::running, ServiceStates::stopped, false);	 // the process died
+	}
+
+	{
+		Journal journal;
+		REQUIRE(journal.open(path));
+		auto& recovery = journal.recovery();
+		CHECK(recovery.interrupted);
+		CHECK(recovery.state == state(ServiceStates::running));
+		CHECK(recovery.from == state(ServiceStates::running) && recovery.to == state(ServiceStates::stopped));
+	}
+
+	// The recovery appended the revert
+	Journal journal;
+	REQUIRE(journal.open(path));
+	CHECK(!journal.recovery().interrupted);
+	CHECK(journal.recovery().state == state(ServiceStates::running));
+	journal.close();
+	DeleteFileW(path.c_str());
+}
+
+TEST(journal_skips_a_torn_record)
+{
+	auto path = harness::temp_path(L"torn.journal");
+	{
+		Journal journal;
+		REQUIRE(journal.open(path, 16));
+		transition(journal, ServiceStates::installed, ServiceStates::running);	// sequences 1, 2
+		transition(journal, ServiceStates::running, ServiceStates::paused);		// 3, 4
+	}
+
+	// Damage the check byte of the commit, sequence 4 in the slot 4 after the 16 bytes header
+	constexpr LONGLONG record = 16, header = 16, check = 11;
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	REQUIRE(file != INVALID_HANDLE_VALUE);
+	LARGE_INTEGER offset{};
+	offset.QuadPart = header + 4 * record + check;
+	uint8_t value	= 0;
+	DWORD done		= 0;
+	SetFilePointerEx(file, offset, NULL, FILE_BEGIN);
+	ReadFile(file, &value, 1, &done, NULL);
+	value ^= 0xFF;
+	SetFilePointerEx(file, offset, NULL, FILE_BEGIN);
+	WriteFile(file, &value, 1, &done, NULL);
+	CloseHandle(file);
+
+	// The begin before it is the last valid record
+	Journal journal;
+	REQUIRE(journal.open(path, 16));
+	CHECK(journal.recovery().interrupted);
+	CHECK(journal.recovery().state == state(ServiceStates::running));
+	journal.close();
+	DeleteFileW(path.c_str());
+}
+
+TEST(journal_wraps_around_its_capacity)
+{
+	auto path = harness::temp_path(L"wrap.journal");
+	{
+		Journal journal;
+		REQUIRE(journal.open(path, 16));
+		for (int i = 0; i < 100; i++) {
+			transition(journal, ServiceStates::running, ServiceStates::paused);
+			transition(journal, ServiceStates::paused, ServiceStates::running);
+		}
+		transition(journal, ServiceStates::running, ServiceStates::stopped);
+	}
+
+	Journal journal;
+	REQUIRE(journal.open(path, 1024));	// keeps its capacity
+	CHECK(journal.recovery().found);
+	CHECK(journal.recovery().state == state(ServiceStates::stopped));
+	journal.close();
+	DeleteFileW(path.c_str());
+}
+
+TEST(journal_starts_over_another_file)
+{
+	auto path	= harness::temp_path(L"other.journal");
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+	REQUIRE(file != INVALID_HANDLE_VALUE);
+	char text[256] = "not a journal";
+	DWORD written  = 0;
+	WriteFile(file, text, sizeof(text), &written, NULL);
+	CloseHandle(file);
+
+	Journal journal;
+	REQUIRE(journal.open(path));
+	CHECK(!journal.recovery().found);
+	journal.close();
+	DeleteFileW(path.c_str());
+}
+
+BENCH(journal_append_and_flush)
+{
+	auto path = harness::temp_path(L"bench.journal");
+	Journal journal;
+	REQUIRE(journal.open(path));
+
+	constexpr int appends = 1000000;
+	auto begin			  = harness::now_us();
+	for (int i = 0; i < appends; i++) {
+		journal.append(state(ServiceStates::running), state(ServiceStates::paused), TransitionPhase::begin);
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("append", elapsed * 1e3 / appends, "ns");
+
+	// A transition made durable, the flusher groups the appends of its window
+	constexpr int flushes = 100;
+	begin				  = harness::now_us();
+	for (int i = 0; i < flushes; i++) {
+		transition(journal, ServiceStates::running, ServiceStates::paused);
+		journal.flush();
+	}
+	elapsed = harness::now_us() - begin;
+	harness::report("durable transition", static_cast<double>(elapsed) / flushes, "us");
+
+	journal.close();
+	DeleteFileW(path.c_str());
+}
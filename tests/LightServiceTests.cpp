@@ -0,0 +1,184 @@
+#include <Windows.h>
+#include <Psapi.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LightService.h"
+#include "Service.h"
+#include "harness.h"
+
+// A host of the test replaces the host of the dispatcher for the SCM entry points, the tests don't dispatch
+namespace
+{
+bool start_light(LightService&)
+{
+	return true;
+}
+
+std::atomic<size_t> s_Stopped{0};
+std::atomic<DWORD> s_StopThread{0};
+
+void stop_light(LightService&)
+{
+	s_StopThread = GetCurrentThreadId();
+	s_Stopped++;
+}
+
+bool wait_stopped(size_t count, DWORD timeout)
+{
+	for (auto deadline = GetTickCount64() + timeout; s_Stopped.load() < count; Sleep(0)) {
+		if (GetTickCount64() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// A full service with nothing of its own, for the footprint comparison
+struct EmptyService : Service {
+};
+
+SIZE_T private_bytes()
+{
+	PROCESS_MEMORY_COUNTERS_EX counters{};
+	counters.cb = sizeof(counters);
+	GetProcessMemoryInfo(GetCurrentProcess(),
+						 reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+						 sizeof(counters));
+	return counters.PrivateUsage;
+}
+}  // namespace
+
+TEST(light_host_finds_its_services_by_name)
+{
+	LightHost host;
+	LightKind kind;
+	int context = 0;
+
+	std::wstring name = L"light_0";
+	auto svc		  = host.add(name, kind, &context);
+	REQUIRE(svc != nullptr);
+	name[0] = L'X';	 // the host keeps its own copy
+	CHECK(std::wstring_view(svc->name()) == L"light_0");
+	CHECK(svc->context == &context);
+	CHECK(svc->state() == ServiceStates::installed);
+
+	CHECK(host.find(L"light_0") == svc);
+	CHECK(host.find(L"light_1") == nullptr);
+	CHECK(host.add(L"light_0", kind) == nullptr);  // taken
+	CHECK(host.size() == 1);
+}
+
+TEST(light_host_interns_the_kinds)
+{
+	LightHost host;
+	LightKind manual, automatic;
+	automatic.start		 = start_light;
+	automatic.start_type = SERVICE_AUTO_START;
+
+	auto a = host.add(L"a", manual);
+	auto b = host.add(L"b", LightKind{});
+	auto c = host.add(L"c", automatic);
+	REQUIRE(a && b && c);
+	CHECK(&a->kind() == &b->kind());
+	CHECK(&a->kind() != &c->kind());
+	CHECK(c->kind().start == start_light);
+}
+
+TEST(light_host_appends_its_table_entries)
+{
+	LightHost host;
+	for (int i = 0; i < 100; i++) {
+		host.add(L"light_" + std::to_wstring(i), LightKind{});
+	}
+
+	std::vector<SERVICE_TABLE_ENTRYW> table{{const_cast<LPWSTR>(L"full"), nullptr}};
+	host.table(table);
+	REQUIRE(table.size() == 101);
+	CHECK(std::wstring_view(table[1].lpServiceName) == L"light_0");
+	CHECK(std::wstring_view(table[100].lpServiceName) == L"light_99");
+	CHECK(table[1].lpServiceProc != nullptr && table[1].lpServiceProc == table[100].lpServiceProc);
+}
+
+TEST(light_host_dispatches_a_stop_on_its_thread)
+{
+	LightHost host;
+	LightKind kind;
+	kind.stop = stop_light;
+	auto svc  = host.add(L"light", kind);
+	REQUIRE(svc);
+
+	s_Stopped = 0;
+	CHECK(host.control(*svc, SERVICE_CONTROL_INTERROGATE) == NO_ERROR);
+	CHECK(host.control(*svc, SERVICE_CONTROL_PAUSE) == ERROR_CALL_NOT_IMPLEMENTED);
+	CHECK(host.control(*svc, SERVICE_CONTROL_STOP) == NO_ERROR);
+	REQUIRE(wait_stopped(1, 2000));
+	CHECK(svc->state() == ServiceStates::stopped);
+	CHECK(s_StopThread != GetCurrentThreadId());
+
+	host.control(*svc, SERVICE_CONTROL_STOP);  // already stopped, the kind isn't called again
+	Sleep(50);
+	CHECK(s_Stopped == 1);
+}
+
+// Bytes per service, registration and control dispatch at 1k and 10k services, light against full
+BENCH(light_service_footprint)
+{
+	harness::report("light service, sizeof", sizeof(LightService), "bytes");
+	harness::report("full service, sizeof", sizeof(EmptyService), "bytes");
+
+	for (size_t count : {1000, 10000}) {
+		auto metric = [count](const char* name) { return std::to_string(count) + " " + name; };
+		std::vector<std::wstring> names;
+		names.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			names.push_back(L"footprint_service_" + std::to_wstring(i));
+		}
+
+		// Private bytes include the allocator overhead, which sizeof doesn't show
+		auto before = private_bytes();
+		auto begin	= harness::now_us();
+		{
+			LightHost host;
+			LightKind kind;
+			kind.stop = stop_light;
+			std::vector<LightService*> services;
+			services.reserve(count);
+			for (auto& name : names) {
+				services.push_back(host.add(name, kind));
+			}
+			auto elapsed = harness::now_us() - begin;
+			auto used	 = private_bytes() - before;
+			auto bytes	 = static_cast<double>(used) / count;
+			harness::report(metric("light, private bytes").c_str(), bytes, "bytes");
+			harness::report(metric("light, add").c_str(), elapsed * 1e3 / count, "ns");
+
+			// From the handler to the stop of the kind on the host thread
+			s_Stopped = 0;
+			begin	  = harness::now_us();
+			for (auto svc : services) {
+				host.control(*svc, SERVICE_CONTROL_STOP);
+			}
+			REQUIRE(wait_stopped(count, 10000));
+			elapsed = harness::now_us() - begin;
+			harness::report(metric("light, stop dispatch").c_str(), elapsed * 1e3 / count, "ns");
+		}
+
+		before = private_bytes();
+		begin  = harness::now_us();
+		{
+			std::vector<std::unique_ptr<EmptyService>> services;
+			for (size_t i = 0; i < count; i++) {
+				services.push_back(std::make_unique<EmptyService>());
+			}
+			auto elapsed = harness::now_us() - begin;
+			auto used	 = private_bytes() - before;
+			auto bytes	 = static_cast<double>(used) / count;
+			harness::report(metric("full, private bytes").c_str(), bytes, "bytes");
+			harness::report(metric("full, construct").c_str(), elapsed * 1e3 / count, "ns");
+		}
+	}
+}
@@ -0,0 +1,224 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "HostedService.h"
+#include "PauseGate.h"
+
+namespace
+{
+struct PauseService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestPause";
+	PauseService() : HostedService(service_name) {}
+};
+
+// A pausable worker counting its rounds
+void spin(HostedService& svc, std::atomic<uint64_t>& rounds)
+{
+	svc.spawn([&svc, &rounds](std::stop_token token) {
+		while (!token.stop_requested()) {
+			rounds++;
+			svc.checkpoint();
+		}
+	}, true);
+}
+
+bool progresses(const std::atomic<uint64_t>& rounds)
+{
+	auto before = rounds.load();
+	Sleep(50);
+	return rounds.load() != before;
+}
+}  // namespace
+
+TEST(gate_parks_the_entered_workers)
+{
+	PauseGate gate;
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> rounds{0};
+	std::vector<std::thread> workers;
+	for (int i = 0; i < 4; i++) {
+		gate.enter();
+		workers.emplace_back([&] {
+			while (!done) {
+				rounds++;
+				gate.checkpoint();
+			}
+			gate.leave();
+		});
+	}
+
+	gate.close();
+	CHECK(gate.wait_quiesced(5000));
+	CHECK(!progresses(rounds));
+
+	gate.open();
+	CHECK(progresses(rounds));
+	done = true;
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+TEST(gate_times_out_on_a_worker_missing_its_checkpoint)
+{
+	PauseGate gate;
+	gate.enter();  // never reaches a checkpoint
+	gate.close();
+	auto begin = GetTickCount64();
+	CHECK(!gate.wait_quiesced(100));
+	CHECK(GetTickCount64() - begin >= 90);
+	gate.open();
+	gate.leave();
+}
+
+TEST(pause_quiesces_the_pausable_workers)
+{
+	Hosted<PauseService> svc;
+	std::atomic<uint64_t> rounds{0};
+	svc->on_start = [&] {
+		for (int i = 0; i < 4; i++) {
+			spin(*svc, rounds);
+		}
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	REQUIRE(svc.pause());
+	CHECK(svc->state() == ServiceStates::paused);
+	CHECK(!progresses(rounds));
+	CHECK(svc->quiesce_latency() < 1000);
+
+	REQUIRE(svc.run());	 // resumes
+	CHECK(svc->state() == ServiceStates::running);
+	CHECK(progresses(rounds));
+}
+
+TEST(pause_doesnt_escalate_the_parked_heartbeats)
+{
+	Hosted<PauseService> svc;
+	svc->on_start = [&] {
+		auto heartbeat = svc->watchdog.enroll(L"worker", 50, Watchdog::Escalation::stop);
+		svc->spawn([&svc, heartbeat](std::stop_token token) {
+			while (!token.stop_requested()) {
+				heartbeat->beat();
+				svc->checkpoint();
+				Sleep(1);
+			}
+		}, true);
+		return true;
+	};
+
+	// Scanned here in place of the idle thread the SCM runs
+	int escalated = 0;
+	auto count	  = [&escalated](const Watchdog::Heartbeat&) { escalated++; };
+	REQUIRE(svc.run());
+	REQUIRE(svc.pause());
+	svc->watchdog.scan(count);
+	Sleep(200);
+	svc->watchdog.scan(count);
+	CHECK(escalated == 0);
+
+	REQUIRE(svc.run());	 // resumes, the deadline restarts
+	svc->watchdog.scan(count);
+	Sleep(20);
+	svc->watchdog.scan(count);
+	CHECK(escalated == 0);
+	CHECK(svc->state() == ServiceStates::running);
+}
+
+TEST(pause_wakes_a_worker_blocked_in_a_wait)
+{
+	Hosted<PauseService> svc;
+	HANDLE event = CreateEventW(NULL, FALSE, FALSE, NULL);
+	REQUIRE(event);
+	svc->on_start = [&] {
+		svc->spawn([&](std::stop_token token) {
+			std::stop_callback onStop(token, [event] { SetEvent(event); });
+			while (!token.stop_requested()) {
+				WaitForSingleObject(event, INFINITE);
+				svc->checkpoint();
+			}
+		}, true, [event] { SetEvent(event); });
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	CHECK(svc.pause());
+	CHECK(svc.stop());
+	CloseHandle(event);
+}
+
+TEST(pause_fails_back_to_running_past_the_timeout)
+{
+	Hosted<PauseService> svc;
+	std::atomic<bool> release{false};
+	svc->cfg.pause_timeout = 100;
+	svc->on_start = [&] {
+		svc->spawn([&](std::stop_token) {
+			while (!release) {	// never reaches a checkpoint
+				Sleep(1);
+			}
+		}, true);
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	CHECK(!svc.pause());
+	CHECK(svc->state() == ServiceStates::running);
+	release = true;
+	CHECK(svc.stop());
+}
+
+TEST(stop_while_paused_then_run_keeps_the_timers_turning)
+{
+	Hosted<PauseService> svc;
+	std::atomic<uint32_t> fired{0};
+	svc->on_start = [&] {
+		svc->timers.schedule_periodic(10, [&fired] { fired++; });
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	REQUIRE(svc.pause());
+	REQUIRE(svc.stop());
+	CHECK(svc->state() == ServiceStates::stopped);
+
+	fired = 0;
+	REQUIRE(svc.run());
+	Sleep(200);
+	CHECK(fired > 0);
+}
+
+BENCH(pause_checkpoint_and_quiesce)
+{
+	constexpr int iterations = 10000000;
+	PauseGate gate;
+	auto begin = harness::now_us();
+	for (int i = 0; i < iterations; i++) {
+		gate.checkpoint();
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("checkpoint, open gate", elapsed * 1e3 / iterations, "ns");
+
+	Hosted<PauseService> svc;
+	std::atomic<uint64_t> rounds{0};
+	svc->on_start = [&] {
+		for (int i = 0; i < 8; i++) {
+			spin(*svc, rounds);
+		}
+		return true;
+	};
+	REQUIRE(svc.run());
+
+	constexpr int cycles = 100;
+	uint64_t pausing	 = 0;
+	for (int i = 0; i < cycles; i++) {
+		auto start = harness::now_us();
+		REQUIRE(svc.pause());
+		pausing += harness::now_us() - start;
+		REQUIRE(svc.run());
+	}
+	harness::report("pause of 8 workers", static_cast<double>(pausing) / cycles, "us");
+	harness::report("max quiesce latency", svc->max_quiesce_latency(), "ms");
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <future>
+#include <vector>
+
+#include "HostedService.h"
+
+namespace
+{
+struct PlacedService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestPlaced";
+	PlacedService() : HostedService(service_name) {}
+};
+
+struct Placement {
+	GROUP_AFFINITY affinity{};
+	int priority = 0;
+};
+
+// Saturates the processors it may run on
+struct BatchService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestBatch";
+	BatchService() : HostedService(service_name) {}
+};
+
+// A unit of the latency sensitive loop, some 10 us of computation
+void work()
+{
+	volatile uint64_t sink = 0;
+	for (int i = 0; i < 5000; i++) {
+		sink = sink + i;
+	}
+}
+
+// The placement a worker of the service runs with
+Placement worker_placement(Hosted<PlacedService>& svc)
+{
+	std::promise<Placement> observed;
+	svc->on_start = [&] {
+		svc->spawn([&observed](std::stop_token) {
+			Placement placement;
+			GetThreadGroupAffinity(GetCurrentThread(), &placement.affinity);
+			placement.priority = GetThreadPriority(GetCurrentThread());
+			observed.set_value(placement);
+		});
+		return true;
+	};
+
+	auto placement = observed.get_future();
+	if (!svc.run()) {
+		return {};
+	}
+	auto result = placement.get();
+	svc.stop();
+	return result;
+}
+
+// The last processor of the group of the calling thread
+GROUP_AFFINITY last_processor()
+{
+	GROUP_AFFINITY current{};
+	GetThreadGroupAffinity(GetCurrentThread(), &current);
+	GROUP_AFFINITY last{};
+	last.Group = current.Group;
+	for (KAFFINITY bit = 1; bit; bit <<= 1) {
+		if (current.Mask & bit) {
+			last.Mask = bit;
+		}
+	}
+	return last;
+}
+}  // namespace
+
+TEST(placement_pins_the_workers)
+{
+	Hosted<PlacedService> svc;
+	auto pinned = last_processor();
+
+	svc->cfg.placement.affinity = pinned;
+	svc->cfg.placement.priority = THREAD_PRIORITY_BELOW_NORMAL;
+
+	auto placement = worker_placement(svc);
+	CHECK(placement.affinity.Mask == pinned.Mask);
+	CHECK(placement.affinity.Group == pinned.Group);
+	CHECK(placement.priority == THREAD_PRIORITY_BELOW_NORMAL);
+}
+
+TEST(placement_uses_the_numa_node_without_a_mask)
+{
+	GROUP_AFFINITY node{};
+	REQUIRE(GetNumaNodeProcessorMaskEx(0, &node));
+
+	Hosted<PlacedService> svc;
+	svc->cfg.placement.numa		 = true;
+	svc->cfg.placement.numa_node = 0;
+
+	auto placement = worker_placement(svc);
+	CHECK(placement.affinity.Mask == node.Mask);
+	CHECK(placement.affinity.Group == node.Group);
+	CHECK(placement.priority == THREAD_PRIORITY_NORMAL);
+}
+
+TEST(placement_leaves_the_workers_alone_by_default)
+{
+	GROUP_AFFINITY process{};
+	GetThreadGroupAffinity(GetCurrentThread(), &process);
+
+	Hosted<PlacedService> svc;
+	auto placement = worker_placement(svc);
+	CHECK(placement.affinity.Mask == process.Mask);
+	CHECK(placement.priority == THREAD_PRIORITY_NORMAL);
+}
+
+// p99 and max of a latency sensitive loop next to a batch service saturating every processor,
+// both unplaced, then the loop pinned to the last processor and the batch kept off it
+BENCH(placement_tail_latency_next_to_a_batch_service)
+{
+	GROUP_AFFINITY current{};
+	GetThreadGroupAffinity(GetCurrentThread(), &current);
+	auto last = last_processor();
+	if (current.Mask == last.Mask) {
+		SKIP("a single processor");
+	}
+	GROUP_AFFINITY others = current;
+	others.Mask &= ~last.Mask;
+
+	constexpr size_t samples = 20000;
+	for (bool pinned : {false, true}) {
+		Hosted<BatchService> batch;
+		Hosted<PlacedService> svc;
+		if (pinned) {
+			batch->cfg.placement.affinity = others;
+			svc->cfg.placement.affinity	  = last;
+		}
+
+		batch->on_start = [&batch, &current] {
+			for (int i = 0; i < std::popcount(current.Mask); i++) {
+				batch->spawn([](std::stop_token token) {
+					while (!token.stop_requested()) {
+						work();
+					}
+				});
+			}
+			return true;
+		};
+
+		std::vector<int64_t> durations;
+		durations.reserve(samples);
+		std::promise<void> done;
+		svc->on_start = [&] {
+			svc->spawn([&](std::stop_token) {
+				for (size_t i = 0; i < samples; i++) {
+					auto begin = harness::now_us();
+					work();
+					durations.push_back(harness::now_us() - begin);
+				}
+				done.set_value();
+			});
+			return true;
+		};
+
+		REQUIRE(batch.run());
+		REQUIRE(svc.run());
+		done.get_future().wait();
+		REQUIRE(svc.stop());
+		REQUIRE(batch.stop());
+
+		std::sort(durations.begin(), durations.end());
+		auto p99 = static_cast<double>(durations[samples * 99 / 100]);
+		auto max = static_cast<double>(durations.back());
+		harness::report(pinned ? "pinned, p99" : "unplaced, p99", p99, "us");
+		harness::report(pinned ? "pinned, max" : "unplaced, max", max, "us");
+	}
+}
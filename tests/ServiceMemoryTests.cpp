@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostedService.h"
+#include "ServiceMemory.h"
+
+namespace
+{
+struct MemoryService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestMemory";
+	MemoryService() : HostedService(service_name) {}
+};
+}  // namespace
+
+TEST(memory_accounts_the_arenas)
+{
+	ServiceMemory memory;
+	CHECK(memory.live() == 0);
+
+	std::pmr::vector<uint64_t> startup(100000, 0, memory.startup());
+	CHECK(memory.live() >= 100000 * sizeof(uint64_t));
+
+	auto live = memory.live();
+	void* p	  = memory.pool()->allocate(256, 64);
+	CHECK(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+	CHECK(memory.live() >= live);
+	memory.pool()->deallocate(p, 256, 64);
+	CHECK(memory.peak() >= memory.live());
+}
+
+TEST(memory_release_drops_everything_and_keeps_the_peak)
+{
+	ServiceMemory memory;
+	for (int i = 0; i < 1000; i++) {
+		memory.pool()->allocate(1024);	// not given back
+	}
+	memory.startup()->allocate(1 << 20);
+	auto peak = memory.peak();
+	CHECK(peak >= (1 << 20) + 1000 * 1024);
+
+	memory.release();
+	CHECK(memory.live() == 0);
+	CHECK(memory.peak() == peak);
+
+	// Usable again after the release
+	CHECK(memory.pool()->allocate(64) != nullptr);
+	CHECK(memory.live() > 0);
+}
+
+TEST(memory_pool_is_shared_by_the_workers)
+{
+	ServiceMemory memory;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&memory] {
+			std::pmr::vector<std::pmr::string> strings(memory.pool());
+			for (int i = 0; i < 10000; i++) {
+				strings.emplace_back("a string longer than the small string buffer");
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	CHECK(memory.peak() > 0);
+}
+
+TEST(memory_of_a_service_is_released_when_it_stops)
+{
+	Hosted<MemoryService> svc;
+	svc->on_start = [&] {
+		svc->memory.startup()->allocate(1 << 20);
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	CHECK(svc->memory.live() >= (1 << 20));
+	REQUIRE(svc.stop());
+	CHECK(svc->memory.live() == 0);
+	CHECK(svc->memory.peak() >= (1 << 20));
+}
+
+BENCH(memory_pool_allocation)
+{
+	constexpr int rounds = 1000, batch = 1000;
+	ServiceMemory memory;
+	std::vector<void*> blocks(batch);
+
+	auto begin = harness::now_us();
+	for (int r = 0; r < rounds; r++) {
+		for (auto& block : blocks) {
+			block = memory.pool()->allocate(64);
+		}
+		for (auto& block : blocks) {
+			memory.pool()->deallocate(block, 64);
+		}
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("pool allocate and free, 64 bytes", elapsed * 1e3 / (rounds * batch), "ns");
+
+	begin = harness::now_us();
+	for (int r = 0; r < rounds; r++) {
+		for (auto& block : blocks) {
+			block = ::operator new(64);
+		}
+		for (auto& block : blocks) {
+			::operator delete(block);
+		}
+	}
+	elapsed = harness::now_us() - begin;
+	harness::report("process heap new and delete, 64 bytes", elapsed * 1e3 / (rounds * batch), "ns");
+}
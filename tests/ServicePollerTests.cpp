@@ -0,0 +1,48 @@
+#include <chrono>
+
+#include "ServicePoller.h"
+#include "harness.h"
+
+// The tests only ask for states the services are already in, they never start or stop one
+
+TEST(poller_fails_an_unknown_service_at_once)
+{
+	if (!harness::elevated()) {
+		SKIP("opening the SCM for control needs an elevated runner");
+	}
+
+	ServicePoller poller;
+	bool called = false;
+	poller.on_complete([&called](std::span<const ServicePoller::Completion>) { called = true; });
+
+	auto started = poller.start(L"WsfNoSuchService");
+	REQUIRE(started.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	CHECK(!started.get());
+	CHECK(!poller.stop(L"WsfNoSuchService").get());
+	CHECK(poller.pending() == 0);
+	CHECK(!called);
+}
+
+TEST(poller_completes_a_service_already_in_its_target)
+{
+	if (!harness::elevated()) {
+		SKIP("opening the SCM for control needs an elevated runner");
+	}
+
+	// The event log runs on every system
+	ServicePoller poller;
+	auto started = poller.start(L"EventLog");
+	REQUIRE(started.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	CHECK(started.get());
+	CHECK(poller.pending() == 0);
+}
+
+TEST(poller_returns_promptly_when_idle)
+{
+	auto begin = GetTickCount64();
+	{
+		ServicePoller poller;
+		Sleep(10);	// the poller thread waits for an operation
+	}
+	CHECK(GetTickCount64() - begin < 1000);
+}
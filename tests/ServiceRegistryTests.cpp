@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Service.h"
+#include "ServiceRegistry.h"
+#include "harness.h"
+
+namespace
+{
+struct EmptyService : Service {
+};
+
+std::vector<std::wstring> names(size_t count)
+{
+	std::vector<std::wstring> result;
+	for (size_t i = 0; i < count; i++) {
+		result.push_back(L"registry_" + std::to_wstring(i));
+	}
+	return result;
+}
+
+// Readers looking up the names for `duration` ms while the writer inserts and erases the last one
+struct Churn {
+	double lookups	   = 0;	 // per second
+	uint64_t writes	   = 0;
+	uint32_t max_alive = 0;	 // erased services still referenced by a retired map
+	bool released	   = false;
+};
+
+Churn churn(uint32_t readers, DWORD duration, bool write)
+{
+	ServiceRegistry registry;
+	auto keys = names(64);
+	for (size_t i = 0; i + 1 < keys.size(); i++) {
+		registry.insert(keys[i], std::make_shared<EmptyService>());
+	}
+
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> lookups{0};
+	std::vector<std::thread> threads;
+	for (uint32_t r = 0; r < readers; r++) {
+		threads.emplace_back([&, r] {
+			uint64_t local = 0;
+			for (size_t i = r; !done; i++) {
+				registry.find(keys[i % keys.size()]);
+				local++;
+			}
+			lookups += local;
+		});
+	}
+
+	Churn result;
+	std::vector<std::weak_ptr<Service>> erased;
+	auto begin = harness::now_us();
+	for (auto end = GetTickCount64() + duration; GetTickCount64() < end;) {
+		if (!write) {
+			Sleep(1);
+			continue;
+		}
+
+		auto svc = std::make_shared<EmptyService>();
+		erased.push_back(svc);
+		registry.insert(keys.back(), std::move(svc));
+		registry.erase(keys.back());
+
+		if (++result.writes % 64 == 0) {
+			uint32_t alive = 0;
+			for (auto& weak : erased) {
+				alive += !weak.expired();
+			}
+			result.max_alive = std::max(result.max_alive, alive);
+			std::erase_if(erased, [](auto& weak) { return weak.expired(); });
+		}
+	}
+
+	done = true;
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	auto elapsed = harness::now_us() - begin;
+
+	// The readers left, the next write frees every retired map
+	registry.insert(keys.back(), std::make_shared<EmptyService>());
+	result.released = std::all_of(erased.begin(), erased.end(), [](auto& weak) { return weak.expired(); });
+	result.lookups	= lookups * 1e6 / elapsed;
+	return result;
+}
+}  // namespace
+
+TEST(registry_inserts_finds_and_erases)
+{
+	ServiceRegistry registry;
+	auto first = std::make_shared<EmptyService>();
+	CHECK(registry.insert(L"first", first));
+	CHECK(!registry.insert(L"first", std::make_shared<EmptyService>()));  // taken
+	CHECK(registry.insert(L"second", std::make_shared<EmptyService>()));
+
+	CHECK(registry.find(L"first") == first);
+	CHECK(registry.contains(L"second"));
+	CHECK(!registry.contains(L"third"));
+	CHECK(registry.size() == 2);
+
+	auto snapshot = registry.snapshot();
+	REQUIRE(snapshot.size() == 2);
+	CHECK(snapshot[0].first == L"first" && snapshot[0].second == first);
+
+	CHECK(registry.erase(L"first"));
+	CHECK(!registry.erase(L"first"));
+	CHECK(registry.find(L"first") == nullptr);
+	CHECK(registry.size() == 1);
+}
+
+TEST(registry_releases_an_erased_service)
+{
+	ServiceRegistry registry;
+	std::weak_ptr<Service> weak;
+	{
+		auto svc = std::make_shared<EmptyService>();
+		weak	 = svc;
+		registry.insert(L"erased", std::move(svc));
+	}
+	CHECK(registry.find(L"erased") != nullptr);
+
+	// No reader holds the replaced maps, the erase frees them
+	registry.erase(L"erased");
+	CHECK(weak.expired());
+}
+
+TEST(registry_frees_the_retired_maps_under_churn)
+{
+	auto result = churn(4, 500, true);
+	CHECK(result.writes > 0 && result.lookups > 0);
+	CHECK(result.released);
+}
+
+BENCH(registry_lookup_under_churn)
+{
+	for (uint32_t readers : {1u, 4u, 8u}) {	 // for 1 s each
+		auto quiet	 = churn(readers, 1000, false);
+		auto churned = churn(readers, 1000, true);
+		auto label	 = std::to_string(readers) + " readers";
+		harness::report(("lookups/s, " + label).c_str(), quiet.lookups, "");
+		harness::report(("lookups/s under churn, " + label).c_str(), churned.lookups, "");
+		harness::report(("writes/s under churn, " + label).c_str(), static_cast<double>(churned.writes), "");
+		harness::report(("erased alive at most, " + label).c_str(), churned.max_alive, "");
+		CHECK(churned.released);
+	}
+}
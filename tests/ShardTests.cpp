@@ -0,0 +1,186 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostedService.h"
+#include "ShardRouter.h"
+
+namespace
+{
+constexpr uint32_t put = 1;
+
+// A store whose state is guarded per instance, the shards of a service split the keys and the lock
+struct ShardedStore : HostedService {
+	ShardedStore(const wchar_t* name, const wchar_t* pipe) : HostedService(name)
+	{
+		cfg.command_pipe = pipe;
+		commands.on(put, [this](std::span<const uint8_t>) {
+			std::lock_guard<std::mutex> g(m_Mtx);
+			for (auto end = harness::now_us() + 20; harness::now_us() < end;) {	 // the update
+				YieldProcessor();
+			}
+			m_Puts++;
+			return std::vector<uint8_t>{};
+		});
+	}
+
+private:
+	std::mutex m_Mtx;
+	uint64_t m_Puts = 0;
+};
+
+struct SingleStore : ShardedStore {
+	static inline const wchar_t* service_name = L"WsfTestSingleStore";
+	SingleStore() : ShardedStore(service_name, L"wsf_test_single_store") {}
+};
+
+struct ShardedStores : ShardedStore {
+	static inline const wchar_t* service_name = L"WsfTestShardedStore";
+	ShardedStores() : ShardedStore(service_name, L"wsf_test_sharded_store") {}
+};
+
+struct FileService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestShardFiles";
+	FileService() : HostedService(service_name)
+	{
+		cfg.command_pipe  = L"wsf_test_files";
+		cfg.journal_path  = L"C:\\data\\files.journal";
+		cfg.snapshot_path = L"C:\\data.d\\files";
+	}
+};
+
+// The shard claims its pipe on a worker, retry until it did
+bool connect(CommandClient& client, std::wstring_view pipe)
+{
+	for (int attempt = 0; attempt < 500; attempt++, Sleep(10)) {
+		if (client.connect(pipe)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<uint8_t> key(uint32_t value)
+{
+	auto text = "key_" + std::to_string(value);
+	return {text.begin(), text.end()};
+}
+}  // namespace
+
+TEST(shard_names_and_paths)
+{
+	CHECK(ShardRouter::shard_name(L"svc", 3) == L"svc_3");
+	CHECK(ShardRouter::shard_path(L"C:\\dir\\state.snap", 2) == L"C:\\dir\\state_2.snap");
+	CHECK(ShardRouter::shard_path(L"C:\\dir.d\\journal", 2) == L"C:\\dir.d\\journal_2");
+	CHECK(ShardRouter::shard_path(L"C:\\dir\\.state", 2) == L"C:\\dir\\.state_2");
+	CHECK(ShardRouter::shard_path(L"state.snap", 0) == L"state_0.snap");
+}
+
+TEST(shard_router_spreads_the_keys)
+{
+	constexpr uint32_t shards = 8, keys = 100000;
+	ShardRouter router(L"svc", shards);
+	std::vector<uint32_t> load(shards);
+	for (uint32_t i = 0; i < keys; i++) {
+		auto shard = router.shard(key(i));
+		REQUIRE(shard < shards);
+		CHECK(router.shard(key(i)) == shard);  // stable
+		load[shard]++;
+	}
+
+	for (auto count : load) {
+		CHECK(count > keys / shards * 6 / 10 && count < keys / shards * 14 / 10);
+	}
+	CHECK(router.route(key(0)) == ShardRouter::shard_name(L"svc", router.shard(key(0))));
+}
+
+TEST(shard_router_moves_only_the_keys_of_an_added_shard)
+{
+	constexpr uint32_t keys = 100000;
+	ShardRouter before(L"svc", 8), after(L"svc", 9);
+	uint32_t moved = 0;
+	for (uint32_t i = 0; i < keys; i++) {
+		auto from = before.shard(key(i)), to = after.shard(key(i));
+		if (from != to) {
+			moved++;
+			CHECK(to == 8);
+		}
+	}
+	CHECK(moved > keys / 9 / 2 && moved < keys / 9 * 2);
+}
+
+TEST(shards_get_their_own_files_and_pipe)
+{
+	SCMDispatcher::instance()->add_shards<FileService>(2);
+	for (uint32_t i = 0; i < 2; i++) {
+		auto name = ShardRouter::shard_name(FileService::service_name, i);
+		auto svc  = std::static_pointer_cast<FileService>(SCMDispatcher::instance()->get(name));
+		REQUIRE(svc != nullptr);
+
+		auto suffix = L"_" + std::to_wstring(i);
+		CHECK(std::wstring(svc->cfg.configuration.lpServiceName) == name);
+		CHECK(std::wstring(svc->cfg.command_pipe) == L"wsf_test_files" + suffix);
+		CHECK(std::wstring(svc->cfg.journal_path) == L"C:\\data\\files" + suffix + L".journal");
+		CHECK(std::wstring(svc->cfg.snapshot_path) == L"C:\\data.d\\files" + suffix);
+	}
+}
+
+// Clients updating keys of a store, through a single instance and through shards of it
+BENCH(shard_throughput_1_vs_n)
+{
+	constexpr uint32_t clients = 4, shards = 4, calls = 5000;
+
+	auto measure = [&](const wchar_t* service, const wchar_t* pipe, uint32_t count) {
+		std::vector<std::shared_ptr<Service>> instances;
+		for (uint32_t i = 0; i < count; i++) {
+			auto svc = SCMDispatcher::instance()->get(ShardRouter::shard_name(service, i));
+			if (!svc || !svc->Service::run()) {
+				return 0.0;
+			}
+			instances.push_back(svc);
+		}
+
+		// Each client holds a connection per shard, within the pipe instances of a shard
+		ShardRouter router(service, count);
+		std::atomic<uint32_t> failed{0};
+		auto begin = harness::now_us();
+		std::vector<std::thread> threads;
+		for (uint32_t c = 0; c < clients; c++) {
+			threads.emplace_back([&, c] {
+				std::vector<CommandClient> connections(count);
+				for (uint32_t i = 0; i < count; i++) {
+					if (!connect(connections[i], ShardRouter::shard_name(pipe, i))) {
+						failed++;
+						return;
+					}
+				}
+				CommandReply reply;
+				for (uint32_t n = 0; n < calls; n++) {
+					auto k = key(c * calls + n);
+					if (!connections[router.shard(k)].call(put, k, reply)) {
+						failed++;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto elapsed = harness::now_us() - begin;
+
+		for (auto& svc : instances) {
+			svc->Service::stop();
+		}
+		return failed ? 0.0 : clients * calls * 1e6 / elapsed;
+	};
+
+	SCMDispatcher::instance()->add_shards<SingleStore>(1);
+	SCMDispatcher::instance()->add_shards<ShardedStores>(shards);
+	harness::report("puts/s, 1 shard", measure(SingleStore::service_name, L"wsf_test_single_store", 1), "");
+	harness::report("puts/s, 4 shards",
+					measure(ShardedStores::service_name, L"wsf_test_sharded_store", shards),
+					"");
+}
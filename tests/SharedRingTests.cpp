@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SharedRing.h"
+#include "harness.h"
+
+// The rings live in the Global namespace, creating one needs elevation
+#define REQUIRE_ELEVATED()                                                    \
+	do {                                                                      \
+		if (!harness::elevated()) {                                           \
+			SKIP("creating a Global\\ ring needs elevation");                 \
+		}                                                                     \
+	} while (false)
+
+namespace
+{
+std::wstring ring_name(std::wstring_view name)
+{
+	return L"wsf_test_" + std::to_wstring(GetCurrentProcessId()) + L"_" + std::wstring(name);
+}
+
+// A client writing a record longer than the slot it claims
+struct RogueProducer : RingProducer {
+	bool forge(std::span<const uint8_t> record, uint32_t length)
+	{
+		auto head = m_Header->head.load();
+		if (!try_push(record)) {
+			return false;
+		}
+		slot(head)->length = length;
+		return true;
+	}
+};
+
+std::span<const uint8_t> bytes(const uint64_t& value)
+{
+	return {reinterpret_cast<const uint8_t*>(&value), sizeof(value)};
+}
+}  // namespace
+
+TEST(ring_delivers_records_in_order)
+{
+	REQUIRE_ELEVATED();
+	auto name = ring_name(L"order");
+	RingConsumer consumer;
+	RingProducer producer;
+	REQUIRE(consumer.create(name, 8, 64));
+	REQUIRE(producer.open(name));
+	CHECK(producer.slot_size() == 64);
+
+	for (uint64_t i = 0; i < 5; i++) {
+		CHECK(producer.try_push(bytes(i)));
+	}
+
+	std::vector<uint64_t> received;
+	auto count = consumer.consume([&received](std::span<const uint8_t> record) {
+		uint64_t value = 0;
+		memcpy(&value, record.data(), std::min(record.size(), sizeof(value)));
+		received.push_back(value);
+	}, 256, 0);
+	CHECK(count == 5);
+	CHECK(received == std::vector<uint64_t>({0, 1, 2, 3, 4}));
+
+	// Empty, returns after the timeout
+	CHECK(consumer.consume([](std::span<const uint8_t>) {}, 256, 10) == 0);
+}
+
+TEST(ring_refuses_a_full_ring_and_oversized_records)
+{
+	REQUIRE_ELEVATED();
+	auto name = ring_name(L"full");
+	RingConsumer consumer;
+	RingProducer producer;
+	REQUIRE(consumer.create(name, 4, 16, RingMode::spsc));
+	REQUIRE(producer.open(name));
+
+	std::vector<uint8_t> large(17);
+	CHECK(!producer.try_push(large));
+
+	uint64_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		CHECK(producer.try_push(bytes(value)));
+	}
+	CHECK(!producer.try_push(bytes(value)));
+	CHECK(!producer.push(bytes(value), 20));  // times out
+
+	CHECK(consumer.consume([](std::span<const uint8_t>) {}, 1, 0) == 1);
+	CHECK(producer.try_push(bytes(value)));
+}
+
+TEST(ring_skips_a_record_claiming_more_than_a_slot)
+{
+	REQUIRE_ELEVATED();
+	auto name = ring_name(L"rogue");
+	RingConsumer consumer;
+	RogueProducer rogue;
+	RingProducer producer;
+	REQUIRE(consumer.create(name, 8, 32));
+	REQUIRE(rogue.open(name));
+	REQUIRE(producer.open(name));
+
+	uint64_t first = 1, second = 2;
+	REQUIRE(rogue.forge(bytes(first), 1u << 30));
+	REQUIRE(producer.try_push(bytes(second)));
+
+	std::vector<size_t> lengths;
+	auto count = consumer.consume([&lengths](std::span<const uint8_t> record) {
+		lengths.push_back(record.size());
+	}, 256, 0);
+	CHECK(count == 2);	// the forged slot is released too
+	CHECK(lengths == std::vector<size_t>({sizeof(second)}));
+}
+
+TEST(ring_wakes_every_blocked_producer)
+{
+	REQUIRE_ELEVATED();
+	auto name = ring_name(L"wakeup");
+	RingConsumer consumer;
+	REQUIRE(consumer.create(name, 16, 16));
+
+	// A lost wakeup leaves a producer blocked, the push times out instead of hanging the test
+	constexpr uint32_t producers = 4, records = 20000;
+	std::atomic<uint32_t> failed{0};
+	std::atomic<uint64_t> received{0};
+	std::jthread consuming([&](std::stop_token token) {
+		consumer.run([&received](std::span<const uint8_t>) { received++; }, token, 4);
+	});
+
+	std::vector<std::thread> threads;
+	for (uint32_t p = 0; p < producers; p++) {
+		threads.emplace_back([&] {
+			RingProducer producer;
+			if (!producer.open(name)) {
+				failed += records;
+				return;
+			}
+			for (uint64_t i = 0; i < records; i++) {
+				if (!producer.push(bytes(i), 5000)) {
+					failed++;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (auto deadline = GetTickCount64() + 5000; received < producers * records - failed;) {
+		if (GetTickCount64() >= deadline) {
+			break;
+		}
+		Sleep(1);
+	}
+	consuming.request_stop();
+	CHECK(failed == 0);
+	CHECK(received == producers * records);
+}
+
+BENCH(ring_throughput)
+{
+	REQUIRE_ELEVATED();
+	auto name = ring_name(L"bench");
+	RingConsumer consumer;
+	REQUIRE(consumer.create(name, 4096, 64));
+
+	constexpr uint64_t records = 5000000;
+	std::atomic<uint64_t> received{0};
+	std::jthread consuming([&](std::stop_token token) {
+		consumer.run([&received](std::span<const uint8_t>) { received++; }, token);
+	});
+
+	RingProducer producer;
+	REQUIRE(producer.open(name));
+	auto begin = harness::now_us();
+	for (uint64_t i = 0; i < records; i++) {
+		producer.push(bytes(i));
+	}
+	while (received < records) {
+		YieldProcessor();
+	}
+	auto elapsed = harness::now_us() - begin;
+
+	consuming.request_stop();
+	harness::report("records/s, 1 producer", records * 1e6 / elapsed, "");
+	harness::report("ns per record", elapsed * 1e3 / records, "ns");
+}
@@ -0,0 +1,236 @@
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "HostedService.h"
+#include "Snapshot.h"
+
+namespace
+{
+// Hands a counter over to its next run
+struct WarmService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestWarm";
+	WarmService() : HostedService(service_name) {}
+
+	uint64_t counter = 0;
+	uint64_t loaded	 = 0;
+
+private:
+	bool save(SnapshotWriter& snapshot) override
+	{
+		auto state = snapshot.allocate(sizeof(counter));
+		if (state.empty()) {
+			return false;
+		}
+		memcpy(state.data(), &counter, sizeof(counter));
+		return true;
+	}
+
+	void load(std::span<const uint8_t> state) override
+	{
+		if (state.size() == sizeof(loaded)) {
+			memcpy(&loaded, state.data(), sizeof(loaded));
+		}
+	}
+};
+
+bool write(const std::wstring& path, std::string_view text, uint32_t stateVersion)
+{
+	SnapshotWriter snapshot(path);
+	auto state = snapshot.allocate(text.size());
+	if (state.size() != text.size()) {
+		return false;
+	}
+	memcpy(state.data(), text.data(), text.size());
+	return snapshot.seal(stateVersion) && snapshot.publish();
+}
+
+std::string_view text(std::span<const uint8_t> state)
+{
+	return {reinterpret_cast<const char*>(state.data()), state.size()};
+}
+
+// Rebuilds a 32 MB lookup table on a cold start, a warm start takes it from the snapshot
+struct CacheService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestCache";
+	CacheService() : HostedService(service_name)
+	{
+		on_start = [this] {
+			if (table.empty()) {
+				rebuild();
+			}
+			return true;
+		};
+	}
+
+	std::vector<uint64_t> table;
+
+private:
+	static constexpr size_t entries = 4 * 1024 * 1024;
+
+	void rebuild()
+	{
+		table.resize(entries);
+		for (size_t i = 0; i < entries; i++) {
+			uint64_t x = i;
+			for (int round = 0; round < 8; round++) {  // splitmix64
+				x += 0x9E3779B97F4A7C15ull;
+				x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+				x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+				x ^= x >> 31;
+			}
+			table[i] = x;
+		}
+	}
+
+	bool save(SnapshotWriter& snapshot) override
+	{
+		auto state = snapshot.allocate(table.size() * sizeof(uint64_t));
+		if (state.empty()) {
+			return false;
+		}
+		memcpy(state.data(), table.data(), state.size());
+		return true;
+	}
+
+	void load(std::span<const uint8_t> state) override
+	{
+		if (state.size() == entries * sizeof(uint64_t)) {
+			table.resize(entries);
+			memcpy(table.data(), state.data(), state.size());
+		}
+	}
+};
+
+bool exists(const std::wstring& path)
+{
+	return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+}  // namespace
+
+TEST(snapshot_is_handed_to_a_single_reader)
+{
+	auto path = harness::temp_path(L"handover.snap");
+	REQUIRE(write(path, "warm state", 3));
+
+	{
+		SnapshotReader reader;
+		REQUIRE(reader.open(path, 3));
+		CHECK(text(reader.state()) == "warm state");
+		reader.close();
+		CHECK(reader.state().empty());
+	}
+	CHECK(!exists(path));  // consumed
+
+	SnapshotReader again;
+	CHECK(!again.open(path, 3));
+}
+
+TEST(snapshot_of_another_state_version_is_discarded)
+{
+	auto path = harness::temp_path(L"version.snap");
+	REQUIRE(write(path, "warm state", 3));
+
+	SnapshotReader reader;
+	CHECK(!reader.open(path, 4));
+	CHECK(!exists(path));
+}
+
+TEST(snapshot_corrupted_is_discarded)
+{
+	auto path = harness::temp_path(L"corrupted.snap");
+	REQUIRE(write(path, "warm state", 3));
+
+	// Flip the last byte of the state
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	REQUIRE(file != INVALID_HANDLE_VALUE);
+	LARGE_INTEGER end{};
+	end.QuadPart = -1;
+	char last	 = 0;
+	DWORD done	 = 0;
+	SetFilePointerEx(file, end, NULL, FILE_END);
+	ReadFile(file, &last, 1, &done, NULL);
+	last ^= 0x5A;
+	SetFilePointerEx(file, end, NULL, FILE_END);
+	WriteFile(file, &last, 1, &done, NULL);
+	CloseHandle(file);
+
+	SnapshotReader reader;
+	CHECK(!reader.open(path, 3));
+	DeleteFileW(path.c_str());
+}
+
+TEST(snapshot_unsealed_keeps_the_previous_one)
+{
+	auto path = harness::temp_path(L"unsealed.snap");
+	REQUIRE(write(path, "previous", 1));
+	{
+		SnapshotWriter snapshot(path);
+		CHECK(!snapshot.allocate(16).empty());
+		CHECK(!snapshot.publish());	 // not sealed
+	}
+	CHECK(!exists(path + L".tmp"));
+
+	SnapshotReader reader;
+	REQUIRE(reader.open(path, 1));
+	CHECK(text(reader.state()) == "previous");
+}
+
+TEST(snapshot_warm_restarts_a_service)
+{
+	auto path = harness::temp_path(L"service.snap");
+	Hosted<WarmService> svc;
+	svc->cfg.snapshot_path	  = path.c_str();
+	svc->cfg.snapshot_version = 1;
+
+	REQUIRE(svc.run());
+	CHECK(!svc->warm_started());
+	svc->counter = 42;
+	REQUIRE(svc.stop());
+	CHECK(exists(path));
+
+	REQUIRE(svc.run());
+	CHECK(svc->warm_started());
+	CHECK(svc->loaded == 42);
+	svc->counter = 0;
+	REQUIRE(svc.stop());
+	DeleteFileW(path.c_str());
+}
+
+// Time to ready of a service rebuilding its state cold against taking it from a published snapshot
+BENCH(snapshot_cold_vs_warm_ready_latency)
+{
+	auto path = harness::temp_path(L"cache.snap");
+	Hosted<CacheService> svc;
+	svc->cfg.snapshot_path	  = path.c_str();
+	svc->cfg.snapshot_version = 1;
+
+	constexpr int rounds = 5;
+	int64_t cold = 0, warm = 0;
+	DWORD coldReady = 0, warmReady = 0;
+	for (int i = 0; i < rounds; i++) {
+		DeleteFileW(path.c_str());
+		svc->table.clear();
+		auto begin = harness::now_us();
+		REQUIRE(svc.run());
+		cold += harness::now_us() - begin;
+		coldReady += svc->ready_latency();
+		REQUIRE(!svc->warm_started());
+		REQUIRE(svc.stop());  // publishes the snapshot
+
+		svc->table.clear();
+		begin = harness::now_us();
+		REQUIRE(svc.run());
+		warm += harness::now_us() - begin;
+		warmReady += svc->ready_latency();
+		REQUIRE(svc->warm_started());
+		REQUIRE(svc.stop());
+	}
+
+	harness::report("cold start, run()", cold / 1e3 / rounds, "ms");
+	harness::report("cold start, ready_latency()", static_cast<double>(coldReady) / rounds, "ms");
+	harness::report("warm start, run()", warm / 1e3 / rounds, "ms");
+	harness::report("warm start, ready_latency()", static_cast<double>(warmReady) / rounds, "ms");
+	DeleteFileW(path.c_str());
+}
@@ -0,0 +1,112 @@
+#include <vector>
+
+#include "harness.h"
+#include "service_sm.h"
+
+namespace
+{
+using Phase = TransitionPhase;
+using State = ServiceStates;
+}  // namespace
+
+TEST(transition_commits_or_reverts)
+{
+	ServiceStateMachine sm;
+	{
+		auto t = sm.try_transit(State::installed);
+		REQUIRE(t.has_value());
+	}
+	CHECK(sm.get_state() == State::uninstalled);  // not committed
+
+	sm.try_transit(State::installed)->commit();
+	CHECK(sm.get_state() == State::installed);
+}
+
+TEST(transition_rejects_without_throwing)
+{
+	ServiceStateMachine sm;
+	auto invalid = sm.try_transit(State::paused);
+	REQUIRE(!invalid);
+	CHECK(invalid.error() == TransitionError::invalid);
+	CHECK(sm.get_state() == State::uninstalled);
+
+	auto t = sm.try_transit(State::installed);
+	REQUIRE(t.has_value());
+	auto nested = sm.try_transit(State::uninstalled);  // would deadlock on the lock
+	REQUIRE(!nested);
+	CHECK(nested.error() == TransitionError::reentrant);
+}
+
+TEST(transition_throwing_variant_keeps_its_contract)
+{
+	ServiceStateMachine sm;
+	bool thrown = false;
+	try {
+		sm.transit(State::running);
+	} catch (const char*) {
+		thrown = true;
+	}
+	CHECK(thrown);
+
+	sm.transit(State::installed).commit();
+	CHECK(sm.get_state() == State::installed);
+}
+
+TEST(transition_is_observed_in_phases)
+{
+	ServiceStateMachine sm;
+	std::vector<Phase> phases;
+	sm.observe([&phases](State, State, Phase phase) { phases.push_back(phase); });
+
+	sm.try_transit(State::installed)->commit();
+	sm.try_transit(State::running);	 // reverted
+	sm.try_transit(State::paused);	 // rejected, not observed
+	CHECK(phases == std::vector<Phase>({Phase::begin, Phase::commit, Phase::begin, Phase::revert}));
+}
+
+// A rejected transition is the common case of a control storm, e.g. pause while paused
+BENCH(transition_rejected_expected_vs_exception)
+{
+	constexpr int iterations = 1000000;
+	ServiceStateMachine sm;
+	sm.transit(State::installed).commit();
+
+	int rejected = 0;
+	auto begin	 = harness::now_us();
+	for (int i = 0; i < iterations; i++) {
+		if (!sm.try_transit(State::paused)) {
+			rejected++;
+		}
+	}
+	auto expected = harness::now_us() - begin;
+
+	begin = harness::now_us();
+	for (int i = 0; i < iterations; i++) {
+		try {
+			sm.transit(State::paused);
+		} catch (const char*) {
+			rejected++;
+		}
+	}
+	auto exception = harness::now_us() - begin;
+
+	CHECK(rejected == 2 * iterations);
+	harness::report("rejected, try_transit", expected * 1e3 / iterations, "ns");
+	harness::report("rejected, transit and catch", exception * 1e3 / iterations, "ns");
+	harness::report("speedup", static_cast<double>(exception) / expected, "x");
+}
+
+BENCH(transition_committed)
+{
+	constexpr int iterations = 1000000;
+	ServiceStateMachine sm;
+	sm.transit(State::installed).commit();
+
+	auto begin = harness::now_us();
+	for (int i = 0; i < iterations; i++) {
+		sm.try_transit(State::running)->commit();
+		sm.try_transit(State::stopped)->commit();
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("committed transition", elapsed * 1e3 / (2 * iterations), "ns");
+}
@@ -0,0 +1,32 @@
+#include "Supervisor.h"
+
+#include "harness.h"
+
+TEST(supervisor_refuses_an_unknown_service)
+{
+	if (!harness::elevated()) {
+		SKIP("opening the SCM for control needs an elevated runner");
+	}
+
+	Supervisor supervisor(100);
+	CHECK(!supervisor.watch(L"WsfNoSuchService"));
+	CHECK(supervisor.history(L"WsfNoSuchService").empty());
+}
+
+TEST(supervisor_watches_a_running_service_once)
+{
+	if (!harness::elevated()) {
+		SKIP("opening the SCM for control needs an elevated runner");
+	}
+
+	// The event log runs on every system and is never stopped by the test
+	Supervisor supervisor(100);
+	REQUIRE(supervisor.watch(L"EventLog"));
+	CHECK(!supervisor.watch(L"EventLog"));
+
+	Sleep(300);	 // a few polls of a running service record nothing
+	CHECK(supervisor.history(L"EventLog").empty());
+
+	supervisor.unwatch(L"EventLog");
+	CHECK(supervisor.watch(L"EventLog"));
+}
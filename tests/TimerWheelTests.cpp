@@ -0,0 +1,218 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "HostedService.h"
+#include "TimerWheel.h"
+
+namespace
+{
+struct TimerService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestTimers";
+	TimerService() : HostedService(service_name) {}
+};
+
+bool wait_until(const std::atomic<uint32_t>& count, uint32_t expected, DWORD timeout)
+{
+	for (auto deadline = GetTickCount64() + timeout; count.load() < expected; Sleep(1)) {
+		if (GetTickCount64() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ULONGLONG to_us(const FILETIME& time)
+{
+	return (static_cast<ULONGLONG>(time.dwHighDateTime) << 32 | time.dwLowDateTime) / 10;
+}
+}  // namespace
+
+TEST(timer_one_shot_fires_once_after_its_delay)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	std::atomic<uint32_t> fired{0};
+	auto begin = GetTickCount64();
+	ULONGLONG elapsed = 0;
+	auto id = wheel.schedule(50, [&] {
+		elapsed = GetTickCount64() - begin;
+		fired++;
+	});
+
+	REQUIRE(wait_until(fired, 1, 2000));
+	Sleep(100);
+	CHECK(fired == 1);
+	CHECK(elapsed >= 40 && elapsed < 500);
+	CHECK(!wheel.cancel(id));
+	CHECK(wheel.size() == 0);
+}
+
+TEST(timer_cascades_from_the_coarser_levels)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	// 64 ticks of 10 ms per level, 1.5 s is on the second level
+	std::atomic<uint32_t> fired{0};
+	auto begin = GetTickCount64();
+	ULONGLONG elapsed = 0;
+	wheel.schedule(1500, [&] {
+		elapsed = GetTickCount64() - begin;
+		fired++;
+	});
+
+	REQUIRE(wait_until(fired, 1, 5000));
+	CHECK(elapsed >= 1450 && elapsed < 2000);
+}
+
+TEST(timer_on_a_level_boundary_fires_on_its_tick)
+{
+	TimerWheel wheel;
+
+	// Tick 64 cascades from the second level, tick 65 is one later
+	size_t armed = 0;
+	std::atomic<uint32_t> fired{0};
+	wheel.schedule(640, [&] {
+		armed = wheel.size();
+		fired++;
+	});
+	wheel.schedule(650, [&fired] { fired++; });
+
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+	REQUIRE(wait_until(fired, 2, 5000));
+	CHECK(armed == 1);	// the second one was still armed
+}
+
+TEST(timer_cancel_before_it_fires)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	std::atomic<uint32_t> fired{0};
+	auto id = wheel.schedule(50, [&fired] { fired++; });
+	CHECK(wheel.cancel(id));
+	CHECK(!wheel.cancel(id));
+	Sleep(150);
+	CHECK(fired == 0);
+}
+
+TEST(timer_periodic_rearms_until_cancelled_from_its_callback)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	std::atomic<uint32_t> fired{0};
+	TimerWheel::TimerId id;
+	id = wheel.schedule_periodic(20, [&] {
+		if (++fired == 5) {
+			wheel.cancel(id);
+		}
+	}, 5);
+
+	REQUIRE(wait_until(fired, 5, 2000));
+	Sleep(100);
+	CHECK(fired == 5);
+	CHECK(wheel.size() == 0);
+}
+
+TEST(timer_clear_drops_every_timer)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	std::atomic<uint32_t> fired{0};
+	auto once	  = wheel.schedule(50, [&fired] { fired++; });
+	auto periodic = wheel.schedule_periodic(20, [&fired] { fired++; });
+	CHECK(wheel.size() == 2);
+
+	wheel.clear();
+	CHECK(wheel.size() == 0);
+	CHECK(!wheel.cancel(once));
+	CHECK(!wheel.cancel(periodic));
+	Sleep(150);
+	CHECK(fired == 0);
+}
+
+TEST(timer_suspended_wheel_doesnt_turn)
+{
+	TimerWheel wheel;
+	std::jthread turning([&wheel](std::stop_token token) { wheel.run(token); });
+
+	std::atomic<uint32_t> fired{0};
+	wheel.suspend();
+	wheel.schedule(30, [&fired] { fired++; });
+	Sleep(150);
+	CHECK(fired == 0);
+
+	wheel.resume();
+	CHECK(wait_until(fired, 1, 2000));
+}
+
+TEST(timer_of_a_run_doesnt_fire_in_the_next_one)
+{
+	Hosted<TimerService> svc;
+	std::atomic<uint32_t> fired{0}, first{0};
+	bool firstRun = true;
+	svc->on_start = [&] {
+		if (firstRun) {
+			svc->timers.schedule_periodic(20, [&first] { first++; });
+			svc->timers.schedule(200, [&fired] { fired++; });
+		}
+		return true;
+	};
+
+	REQUIRE(svc.run());
+	REQUIRE(wait_until(first, 1, 2000));
+	REQUIRE(svc.stop());
+	CHECK(svc->timers.size() == 0);
+
+	firstRun = false;
+	auto stopped = first.load();
+	REQUIRE(svc.run());
+	Sleep(300);
+	CHECK(first == stopped);
+	CHECK(fired == 0);
+	CHECK(svc.stop());
+}
+
+// 100k active timers spread over the levels, then a wheel of 1 ms ticks expiring 100k timers over 2 s
+BENCH(timer_wheel_100k_timers)
+{
+	constexpr uint32_t count = 100000;
+	std::minstd_rand random(1);
+	std::vector<TimerWheel::TimerId> ids(count);
+
+	TimerWheel wheel;
+	auto begin = harness::now_us();
+	for (auto& id : ids) {
+		id = wheel.schedule(1 + random() % 600000, [] {});	// up to 10 min
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("arm", elapsed * 1e3 / count, "ns");
+
+	begin = harness::now_us();
+	for (auto& id : ids) {
+		wheel.cancel(id);
+	}
+	elapsed = harness::now_us() - begin;
+	harness::report("cancel", elapsed * 1e3 / count, "ns");
+
+	constexpr DWORD spread = 2000;	// ms, ticks of the second wheel
+	TimerWheel fine(1);
+	std::atomic<uint32_t> fired{0};
+	for (uint32_t i = 0; i < count; i++) {
+		fine.schedule(1 + random() % spread, [&fired] { fired++; });
+	}
+
+	std::jthread turning([&fine](std::stop_token token) { fine.run(token); });
+	REQUIRE(wait_until(fired, count, 10 * spread));
+
+	FILETIME creation, exit, kernel, user;
+	REQUIRE(GetThreadTimes(turning.native_handle(), &creation, &exit, &kernel, &user));
+	auto cpu = to_us(kernel) + to_us(user);
+	harness::report("tick, CPU per tick", static_cast<double>(cpu) / spread, "us");
+	harness::report("tick, CPU per expired timer", cpu * 1e3 / count, "ns");
+}
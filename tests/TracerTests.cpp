@@ -0,0 +1,124 @@
+#include <string>
+#include <thread>
+
+#include "HostedService.h"
+#include "Tracer.h"
+
+namespace
+{
+constexpr TraceName trace_test_instant{"test", "test_instant"};
+constexpr TraceName trace_test_scope{"test", "test_scope"};
+
+struct TracedService : HostedService {
+	static inline const wchar_t* service_name = L"WsfTestTraced";
+	TracedService() : HostedService(service_name) {}
+};
+
+std::string read(const std::wstring& path)
+{
+	std::string content;
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return content;
+	}
+
+	LARGE_INTEGER size{};
+	DWORD read = 0;
+	if (GetFileSizeEx(file, &size)) {
+		content.resize(static_cast<size_t>(size.QuadPart));
+		ReadFile(file, content.data(), static_cast<DWORD>(content.size()), &read, NULL);
+		content.resize(read);
+	}
+	CloseHandle(file);
+	return content;
+}
+
+size_t occurrences(const std::string& content, const std::string& text)
+{
+	size_t count = 0;
+	for (auto at = content.find(text); at != std::string::npos; at = content.find(text, at + text.size())) {
+		count++;
+	}
+	return count;
+}
+}  // namespace
+
+TEST(tracer_records_nothing_while_disabled)
+{
+	CHECK(!Tracer::enabled());
+	Tracer::instant(trace_test_instant);  // doesn't allocate a buffer
+	{
+		Tracer::Scope scope(trace_test_scope);
+	}
+	CHECK(!Tracer::enabled());
+}
+
+TEST(tracer_writes_the_events_of_every_thread)
+{
+	auto path = harness::temp_path(L"timeline.json");
+	REQUIRE(Tracer::start(path, 10));
+	CHECK(Tracer::enabled());
+
+	// More than a chunk on a thread that exits before the flush
+	std::thread([] {
+		for (int i = 0; i < 3000; i++) {
+			Tracer::instant(trace_test_instant, i);
+		}
+	}).join();
+
+	Tracer::instant(trace_test_instant, 42);
+	{
+		Tracer::Scope scope(trace_test_scope);
+		Sleep(1);
+	}
+	Tracer::stop();
+	CHECK(!Tracer::enabled());
+
+	auto content = read(path);
+	DeleteFileW(path.c_str());
+	CHECK(content.rfind("[\n", 0) == 0);
+	CHECK(occurrences(content, "\"name\":\"test_instant\"") == 3001);
+	CHECK(occurrences(content, "\"name\":\"test_scope\",\"cat\":\"test\",\"ph\":\"X\"") == 1);
+	CHECK(occurrences(content, "\"args\":{\"value\":42}") == 1);
+}
+
+TEST(tracer_follows_the_lifecycle_of_a_service)
+{
+	auto path = harness::temp_path(L"lifecycle.json");
+	REQUIRE(Tracer::start(path));
+	{
+		Hosted<TracedService> svc;
+		REQUIRE(svc.run());
+		REQUIRE(svc.stop());
+	}
+	Tracer::stop();
+
+	auto content = read(path);
+	DeleteFileW(path.c_str());
+	CHECK(occurrences(content, "\"name\":\"start\",\"cat\":\"lifecycle\"") == 1);
+	CHECK(occurrences(content, "\"name\":\"stop\",\"cat\":\"lifecycle\"") >= 1);
+	CHECK(occurrences(content, "\"name\":\"start\",\"cat\":\"override\"") == 1);
+}
+
+BENCH(tracer_event_cost)
+{
+	constexpr int events = 10000000;
+	auto begin			 = harness::now_us();
+	for (int i = 0; i < events; i++) {
+		Tracer::instant(trace_test_instant, i);
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("instant, disabled", elapsed * 1e3 / events, "ns");
+
+	auto path = harness::temp_path(L"bench.json");
+	REQUIRE(Tracer::start(path));
+	constexpr int recorded = 1000000;
+	begin				   = harness::now_us();
+	for (int i = 0; i < recorded; i++) {
+		Tracer::instant(trace_test_instant, i);
+	}
+	elapsed = harness::now_us() - begin;
+	Tracer::stop();
+	DeleteFileW(path.c_str());
+	harness::report("instant, enabled", elapsed * 1e3 / recorded, "ns");
+}
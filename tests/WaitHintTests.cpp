@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "WaitHint.h"
+#include "harness.h"
+
+namespace
+{
+using Transition = WaitHint::Transition;
+
+constexpr const wchar_t* service_name = L"WsfTestWaitHint";
+
+std::wstring parameters_key()
+{
+	return L"SYSTEM\\CurrentControlSet\\Services\\" + std::wstring(service_name) + L"\\Parameters";
+}
+
+void delete_service_key()
+{
+	auto key = L"SYSTEM\\CurrentControlSet\\Services\\" + std::wstring(service_name);
+	RegDeleteTreeW(HKEY_LOCAL_MACHINE, key.c_str());
+}
+}  // namespace
+
+TEST(wait_hint_defaults_until_a_transition_was_seen)
+{
+	WaitHint hints;
+	CHECK(hints.hint(Transition::start) == WaitHint::default_hint);
+	CHECK(hints.hint(Transition::resume) == WaitHint::default_hint);
+}
+
+TEST(wait_hint_learns_the_95th_percentile_with_a_margin)
+{
+	WaitHint hints;
+	for (DWORD i = 0; i < 10000; i++) {
+		hints.observe(Transition::stop, 1000 + i % 100 * 100);	// 1000 to 10900 ms, evenly
+	}
+
+	// The 95th percentile is about 10400 ms, with the 1.5 margin
+	auto hint = hints.hint(Transition::stop);
+	CHECK(hint > 14000 && hint < 17000);
+	CHECK(hints.hint(Transition::start) == WaitHint::default_hint);	 // per transition
+}
+
+TEST(wait_hint_keeps_its_floor_and_ceiling)
+{
+	WaitHint hints;
+	for (int i = 0; i < 100; i++) {
+		hints.observe(Transition::pause, 10);
+		hints.observe(Transition::resume, UINT32_MAX);
+	}
+	CHECK(hints.hint(Transition::pause) == WaitHint::min_hint);
+	CHECK(hints.hint(Transition::resume) == WaitHint::max_hint);
+
+	// A fast transition stops over-waiting, its hint falls below the default
+	for (int i = 0; i < 100; i++) {
+		hints.observe(Transition::stop, 1000);
+	}
+	CHECK(hints.hint(Transition::stop) == 1500);
+	CHECK(WaitHint::min_hint < WaitHint::default_hint);
+
+	// A few durations use the nearest rank
+	WaitHint few;
+	few.observe(Transition::start, 4000);
+	few.observe(Transition::start, 2000);
+	CHECK(few.hint(Transition::start) == 6000);
+}
+
+TEST(wait_hint_persists_across_processes)
+{
+	if (!harness::elevated()) {
+		SKIP("writing HKLM needs an elevated runner");
+	}
+
+	WaitHint saved;
+	for (DWORD i = 0; i < 100; i++) {
+		saved.observe(Transition::start, 5000 + i);
+	}
+	REQUIRE(saved.save(service_name));
+
+	WaitHint loaded;
+	CHECK(loaded.load(service_name));
+	CHECK(loaded.hint(Transition::start) == saved.hint(Transition::start));
+	delete_service_key();
+}
+
+TEST(wait_hint_discards_a_corrupt_state)
+{
+	if (!harness::elevated()) {
+		SKIP("writing HKLM needs an elevated runner");
+	}
+
+	WaitHint saved;
+	saved.observe(Transition::stop, 5000);
+	REQUIRE(saved.save(service_name));
+
+	// The layout is private, corrupt the saved value past its version
+	auto key = parameters_key();
+	std::vector<uint8_t> state(4096);
+	DWORD size = static_cast<DWORD>(state.size());
+	REQUIRE(RegGetValueW(HKEY_LOCAL_MACHINE, key.c_str(), L"WaitHint", RRF_RT_REG_BINARY, NULL, state.data(),
+						 &size) == ERROR_SUCCESS);
+	REQUIRE(size > sizeof(uint32_t));
+	memset(state.data() + sizeof(uint32_t), 0xFF, size - sizeof(uint32_t));	 // NaN heights
+	REQUIRE(RegSetKeyValueW(HKEY_LOCAL_MACHINE, key.c_str(), L"WaitHint", REG_BINARY, state.data(), size) ==
+			ERROR_SUCCESS);
+
+	WaitHint loaded;
+	CHECK(!loaded.load(service_name));
+	CHECK(loaded.hint(Transition::stop) == WaitHint::default_hint);
+
+	// Of another size
+	REQUIRE(RegSetKeyValueW(HKEY_LOCAL_MACHINE, key.c_str(), L"WaitHint", REG_BINARY, state.data(), 8) ==
+			ERROR_SUCCESS);
+	CHECK(!loaded.load(service_name));
+	delete_service_key();
+}
@@ -0,0 +1,66 @@
+#include "Watchdog.h"
+
+#include "harness.h"
+
+TEST(watchdog_escalates_a_stalled_heartbeat_once)
+{
+	Watchdog watchdog;
+	auto stalled = watchdog.enroll(L"stalled", 50);
+	auto beating = watchdog.enroll(L"beating", 50);
+
+	int escalated = 0;
+	auto count = [&escalated](const Watchdog::Heartbeat& heartbeat) {
+		CHECK(heartbeat.name() == L"stalled");
+		escalated++;
+	};
+
+	for (int i = 0; i < 4; i++) {
+		beating->beat();
+		Sleep(40);
+		watchdog.scan(count);
+	}
+	CHECK(escalated == 1);
+
+	// A late beat re-arms it
+	stalled->beat();
+	watchdog.scan(count);
+	Sleep(120);
+	beating->beat();
+	watchdog.scan(count);
+	CHECK(escalated == 2);
+}
+
+TEST(watchdog_drops_released_heartbeats)
+{
+	Watchdog watchdog;
+	watchdog.enroll(L"released", 10);  // not held
+	Sleep(30);
+
+	bool escalated = false;
+	watchdog.scan([&escalated](const Watchdog::Heartbeat&) { escalated = true; });
+	CHECK(!escalated);
+}
+
+TEST(watchdog_scans_twice_per_deadline)
+{
+	Watchdog watchdog;
+	auto heartbeat = watchdog.enroll(L"worker", 400);
+	for (int i = 0; i < 100; i++) {
+		auto wait = watchdog.next_wait();
+		CHECK(wait >= 150 && wait <= 250);
+	}
+}
+
+BENCH(watchdog_beat)
+{
+	Watchdog watchdog;
+	auto heartbeat = watchdog.enroll(L"worker", 1000);
+
+	constexpr int beats = 100000000;
+	auto begin			= harness::now_us();
+	for (int i = 0; i < beats; i++) {
+		heartbeat->beat();
+	}
+	auto elapsed = harness::now_us() - begin;
+	harness::report("beat", elapsed * 1000.0 / beats, "ns");
+}
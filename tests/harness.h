@@ -0,0 +1,65 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Minimal test and benchmark runner of the framework, no dependency beyond the Windows SDK.
+// TEST(name) registers a test, CHECK fails it and goes on, REQUIRE fails it and returns,
+// SKIP returns without failing when the environment can't run it (e.g. not elevated).
+// BENCH(name) registers a benchmark, run with --bench, it prints its figures with report().
+namespace harness
+{
+struct Case {
+	const char* name;
+	void (*run)();
+	bool bench;
+};
+
+std::vector<Case>& cases();
+
+struct Register {
+	Register(const char* name, void (*run)(), bool bench)
+	{
+		cases().push_back({name, run, bench});
+	}
+};
+
+void fail(const char* file, int line, const char* expression);
+void skip(const char* reason);
+void report(const char* metric, double value, const char* unit);
+
+// Unique per process and name, under %TEMP%, deleted by the caller
+std::wstring temp_path(std::wstring_view name);
+
+// Object names in the Global namespace need SeCreateGlobalPrivilege, services and administrators
+bool elevated();
+
+// us since an arbitrary origin
+int64_t now_us();
+}  // namespace harness
+
+#define HARNESS_CASE(name, bench)                                             \
+	static void name();                                                       \
+	static harness::Register register_##name(#name, name, bench);             \
+	static void name()
+
+#define TEST(name)	HARNESS_CASE(name, false)
+#define BENCH(name) HARNESS_CASE(name, true)
+
+#define CHECK(expression) ((expression) ? (void)0 : harness::fail(__FILE__, __LINE__, #expression))
+
+#define REQUIRE(expression)                                                   \
+	do {                                                                      \
+		if (!(expression)) {                                                  \
+			harness::fail(__FILE__, __LINE__, #expression);                   \
+			return;                                                           \
+		}                                                                     \
+	} while (false)
+
+#define SKIP(reason)                                                          \
+	do {                                                                      \
+		harness::skip(reason);                                                \
+		return;                                                               \
+	} while (false)
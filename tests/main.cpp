@@ -0,0 +1,116 @@
+#include <stdio.h>
+
+#include <string>
+
+#include "harness.h"
+
+// WindowsServiceFramework.Tests.exe [--bench] [filter]
+// Runs the tests, or the benchmarks with --bench, whose name contains `filter`.
+// The exit code is the number of failed cases.
+// The dispatcher of a Debug build waits for a debugger, run the Release configuration from a console.
+
+namespace
+{
+bool s_Failed  = false;
+bool s_Skipped = false;
+}  // namespace
+
+namespace harness
+{
+std::vector<Case>& cases()
+{
+	static std::vector<Case> registered;
+	return registered;
+}
+
+void fail(const char* file, int line, const char* expression)
+{
+	s_Failed = true;
+	printf("    %s(%d): CHECK(%s) failed\n", file, line, expression);
+}
+
+void skip(const char* reason)
+{
+	s_Skipped = true;
+	printf("    skipped: %s\n", reason);
+}
+
+void report(const char* metric, double value, const char* unit)
+{
+	printf("    %-40s %14.2f %s\n", metric, value, unit);
+}
+
+std::wstring temp_path(std::wstring_view name)
+{
+	wchar_t directory[MAX_PATH] = {0};
+	GetTempPathW(MAX_PATH, directory);
+	return std::wstring(directory) + L"wsf_" + std::to_wstring(GetCurrentProcessId()) + L"_" + std::wstring(name);
+}
+
+bool elevated()
+{
+	HANDLE token = NULL;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+		return false;
+	}
+
+	TOKEN_ELEVATION elevation{};
+	DWORD size	= 0;
+	bool result = GetTokenInformation(token, TokenElevation, &elevation, sizeof(elevation), &size) &&
+				  elevation.TokenIsElevated;
+	CloseHandle(token);
+	return result;
+}
+
+int64_t now_us()
+{
+	static const int64_t frequency = [] {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / frequency * 1000000 + counter.QuadPart % frequency * 1000000 / frequency;
+}
+}  // namespace harness
+
+int wmain(int argc, wchar_t** argv)
+{
+	bool bench = false;
+	std::string filter;
+	for (int i = 1; i < argc; i++) {
+		std::wstring arg = argv[i];
+		if (arg == L"--bench") {
+			bench = true;
+		} else {
+			filter.assign(arg.begin(), arg.end());	// the names are ASCII
+		}
+	}
+
+	int failed = 0, passed = 0, skipped = 0;
+	for (auto& test : harness::cases()) {
+		if (test.bench != bench || std::string(test.name).find(filter) == std::string::npos) {
+			continue;
+		}
+
+		s_Failed = s_Skipped = false;
+		printf("[ RUN  ] %s\n", test.name);
+		test.run();
+
+		if (s_Failed) {
+			failed++;
+			printf("[ FAIL ] %s\n", test.name);
+		} else if (s_Skipped) {
+			skipped++;
+			printf("[ SKIP ] %s\n", test.name);
+		} else {
+			passed++;
+			printf("[  OK  ] %s\n", test.name);
+		}
+	}
+
+	printf("%d passed, %d failed, %d skipped\n", passed, failed, skipped);
+	return failed;
+}